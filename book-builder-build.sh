@@ -0,0 +1 @@
+gcc lichess-bot/src/lichess_book_builder.c lichess-bot/src/lichess_book.c lichess-bot/src/lichess_random.c lichess-bot/src/lichess_game.c lichess-bot/src/lichess_nnue.c -I lichess-bot/include -I include -o bookbuilder -std=c99 -Wall -O3 -pthread -lpthread -lm
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "nnue.h"
+
 // Piece flags
 #define PIECE_TYPE_MASK 7
 #define PIECE_OWNER_MASK 24
@@ -36,24 +38,19 @@
 #define CASTLE_BLACK_KING 4
 #define CASTLE_BLACK_QUEEN 8
 
-typedef struct Position
-{
-    uint64_t hash;
-    int occurences;
-    uint8_t playerToMove;
-    uint8_t enPassantSquare;
-    uint8_t castlingAvailability;
-    uint8_t board[64];
-} Position;
-
 typedef struct GameState
 {
     uint64_t hash;
+    uint64_t pawnHash; // Zobrist hash of the pawns alone
     int halfMoves; // Resets when a pawn is moved or a piece is captured.  Used for 50 move draw rule.
     uint8_t playerToMove;
     uint8_t enPassantSquare;
     uint8_t castlingAvailablity;
     uint8_t board[64];
+    int middlegameScore; // Material and piece-square scores from white's side, kept up to date by movePiece
+    int endgameScore;
+    int phase;
+    NNUEAccumulator accumulator; // Only maintained while a network is loaded
 } GameState;
 
 typedef struct Zobrist
@@ -67,6 +64,33 @@ typedef struct Zobrist
     uint64_t whiteKingCastle;
 } Zobrist;
 
+#define MAX_PV_LENGTH 64
+
+// What the search found at one depth
+typedef struct SearchInfo
+{
+    int depth;
+    int score; // From the side to move's point of view
+    int mate; // Moves to mate, negative when being mated, 0 if the score isn't a mate
+    uint64_t nodes; // Counted over all search threads
+    uint64_t time; // Milliseconds since the search started
+    uint16_t pv[MAX_PV_LENGTH];
+    int pvLength;
+    bool terminal; // No legal moves.  The score is the checkmate or stalemate result and there's no search to report.
+} SearchInfo;
+
+typedef void (*SearchReport)(const SearchInfo *info);
+
+typedef struct SearchLimits
+{
+    int depth;
+    uint64_t nodes; // 0 for no limit
+    uint64_t time; // Milliseconds, 0 for no limit
+    volatile bool *stop; // Set from another thread to abort the search
+    int variety; // Root moves scoring within this margin of the best move are picked at random
+    SearchReport report; // Called after each depth the main search thread completes, NULL for none
+} SearchLimits;
+
 enum GameEnd
 {
     GAME_NOT_OVER, CHECKMATE, STALEMATE, DRAW_50_MOVE, DRAW_REPITITION
@@ -75,11 +99,25 @@ enum GameEnd
 extern GameState gameState;
 
 void movePiece(uint16_t move, GameState *state);
+int getAllLegalMoves(uint16_t *moves, GameState *state);
+void moveToString(uint16_t move, char *string);
+void loadFenString(const char *str);
 int pieceLegalMoves(uint8_t cell, uint16_t *moves, GameState *state);
 void initZobrist(void);
+void initSearch(void);
+void clearEvaluationCache(void);
 void initGameState(void);
 uint16_t getComputerMove(void);
+void startPondering(void);
+void stopPondering(void);
+void stopSearch(void);
+void setSearchLimits(int depth, uint64_t nodes, uint64_t time);
+void setSearchReport(SearchReport report);
+bool setHashSize(int megabytes);
+void clearHash(void);
+void setSearchThreads(int threads);
 enum GameEnd checkGameEnd(GameState *state);
 void runTests(bool verbose);
+void runAnalysis(const char *fileName, int numLines);
 
 #endif
@@ -9,10 +9,11 @@ typedef struct RngState
     uint64_t inc;
 } RngState;
 
+// The main thread's generator.  Threads that need random numbers at the same time have their own.
 extern RngState rngState;
 
-uint32_t pcgGetRandom(void);
-uint64_t pcgGetRandom64(void);
-uint32_t pcgRangedRandom(uint32_t range);
+uint32_t pcgGetRandom(RngState *rng);
+uint64_t pcgGetRandom64(RngState *rng);
+uint32_t pcgRangedRandom(uint32_t range, RngState *rng);
 
 #endif
@@ -1,11 +1,16 @@
 #ifndef PLATFORM_H
 #define PLATFORM_H
 
+#include <stdint.h>
+
 #define LOG_SIZE 256
 
 void blitToScreen(void);
 void *loadFile(const char *fileName);
 void debugLog(const char *message);
 void makeComputerMove(void);
+void *createThread(void *(*function)(void *), void *arg);
+void joinThread(void *thread);
+uint64_t getTime(void);
 
 #endif
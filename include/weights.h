@@ -0,0 +1,168 @@
+// Evaluation weights in centipawns.  Set by hand to start with.  The tuner (see tuner-build.sh) rewrites this file.
+#ifndef WEIGHTS_H
+#define WEIGHTS_H
+
+// The tuner build defines WEIGHT so the weights can be changed at run time
+#ifndef WEIGHT
+#define WEIGHT static const
+#endif
+
+// Material and piece-square values for the middlegame and endgame, indexed by piece type.
+// Tables are from white's side with a8 first.  Black pieces look up the square mirrored vertically.
+WEIGHT int middlegameValues[7] = {0, 100, 330, 320, 500, 900, 0};
+WEIGHT int endgameValues[7] = {0, 120, 320, 300, 520, 940, 0};
+WEIGHT int middlegameTables[7][64] =
+{
+    {0},
+    // Pawn
+    {
+           0,    0,    0,    0,    0,    0,    0,    0,
+          50,   50,   50,   50,   50,   50,   50,   50,
+          10,   10,   20,   30,   30,   20,   10,   10,
+           5,    5,   10,   25,   25,   10,    5,    5,
+           0,    0,    0,   20,   20,    0,    0,    0,
+           5,   -5,  -10,    0,    0,  -10,   -5,    5,
+           5,   10,   10,  -20,  -20,   10,   10,    5,
+           0,    0,    0,    0,    0,    0,    0,    0
+    },
+    // Bishop
+    {
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -10,    0,    5,   10,   10,    5,    0,  -10,
+         -10,    5,    5,   10,   10,    5,    5,  -10,
+         -10,    0,   10,   10,   10,   10,    0,  -10,
+         -10,   10,   10,   10,   10,   10,   10,  -10,
+         -10,    5,    0,    0,    0,    0,    5,  -10,
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20
+    },
+    // Knight
+    {
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+         -40,  -20,    0,    0,    0,    0,  -20,  -40,
+         -30,    0,   10,   15,   15,   10,    0,  -30,
+         -30,    5,   15,   20,   20,   15,    5,  -30,
+         -30,    0,   15,   20,   20,   15,    0,  -30,
+         -30,    5,   10,   15,   15,   10,    5,  -30,
+         -40,  -20,    0,    5,    5,    0,  -20,  -40,
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50
+    },
+    // Rook
+    {
+           0,    0,    0,    0,    0,    0,    0,    0,
+           5,   10,   10,   10,   10,   10,   10,    5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+           0,    0,    0,    5,    5,    0,    0,    0
+    },
+    // Queen
+    {
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -10,    0,    5,    5,    5,    5,    0,  -10,
+          -5,    0,    5,    5,    5,    5,    0,   -5,
+           0,    0,    5,    5,    5,    5,    0,   -5,
+         -10,    5,    5,    5,    5,    5,    0,  -10,
+         -10,    0,    5,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20
+    },
+    // King
+    {
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -20,  -30,  -30,  -40,  -40,  -30,  -30,  -20,
+         -10,  -20,  -20,  -20,  -20,  -20,  -20,  -10,
+          20,   20,    0,    0,    0,    0,   20,   20,
+          20,   30,   10,    0,    0,   10,   30,   20
+    }
+};
+
+WEIGHT int endgameTables[7][64] =
+{
+    {0},
+    // Pawn
+    {
+           0,    0,    0,    0,    0,    0,    0,    0,
+          80,   80,   80,   80,   80,   80,   80,   80,
+          50,   50,   50,   50,   50,   50,   50,   50,
+          30,   30,   30,   30,   30,   30,   30,   30,
+          15,   15,   15,   15,   15,   15,   15,   15,
+           5,    5,    5,    5,    5,    5,    5,    5,
+           0,    0,    0,    0,    0,    0,    0,    0,
+           0,    0,    0,    0,    0,    0,    0,    0
+    },
+    // Bishop
+    {
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -10,    0,    5,   10,   10,    5,    0,  -10,
+         -10,    5,    5,   10,   10,    5,    5,  -10,
+         -10,    0,   10,   10,   10,   10,    0,  -10,
+         -10,   10,   10,   10,   10,   10,   10,  -10,
+         -10,    5,    0,    0,    0,    0,    5,  -10,
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20
+    },
+    // Knight
+    {
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+         -40,  -20,    0,    0,    0,    0,  -20,  -40,
+         -30,    0,   10,   15,   15,   10,    0,  -30,
+         -30,    5,   15,   20,   20,   15,    5,  -30,
+         -30,    0,   15,   20,   20,   15,    0,  -30,
+         -30,    5,   10,   15,   15,   10,    5,  -30,
+         -40,  -20,    0,    5,    5,    0,  -20,  -40,
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50
+    },
+    // Rook
+    {
+           0,    0,    0,    0,    0,    0,    0,    0,
+           5,   10,   10,   10,   10,   10,   10,    5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+           0,    0,    0,    5,    5,    0,    0,    0
+    },
+    // Queen
+    {
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -10,    0,    5,    5,    5,    5,    0,  -10,
+          -5,    0,    5,    5,    5,    5,    0,   -5,
+           0,    0,    5,    5,    5,    5,    0,   -5,
+         -10,    5,    5,    5,    5,    5,    0,  -10,
+         -10,    0,    5,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20
+    },
+    // King
+    {
+         -50,  -40,  -30,  -20,  -20,  -30,  -40,  -50,
+         -30,  -20,  -10,    0,    0,  -10,  -20,  -30,
+         -30,  -10,   20,   30,   30,   20,  -10,  -30,
+         -30,  -10,   30,   40,   40,   30,  -10,  -30,
+         -30,  -10,   30,   40,   40,   30,  -10,  -30,
+         -30,  -10,   20,   30,   30,   20,  -10,  -30,
+         -30,  -30,    0,    0,    0,    0,  -30,  -30,
+         -50,  -30,  -30,  -30,  -30,  -30,  -30,  -50
+    }
+};
+
+// Pawn structure.  Passed pawn bonuses are indexed by how far the pawn has advanced, the rest are middlegame then endgame.
+WEIGHT int passedPawnMiddlegame[8] = {0, 5, 10, 15, 30, 50, 80, 0};
+WEIGHT int passedPawnEndgame[8] = {0, 10, 15, 25, 45, 75, 120, 0};
+WEIGHT int doubledPawn[2] = {-10, -20};
+WEIGHT int isolatedPawn[2] = {-10, -15};
+WEIGHT int backwardPawn[2] = {-8, -10};
+
+// Mobility per square beyond the typical count and king attack units per square of the king zone, indexed by piece type.
+WEIGHT int mobilityMiddlegame[7] = {0, 0, 5, 4, 2, 1, 0};
+WEIGHT int mobilityEndgame[7] = {0, 0, 5, 4, 4, 2, 0};
+WEIGHT int kingAttackWeights[7] = {0, 0, 2, 2, 3, 5, 0};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <windows.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 extern HDC windowDC;
 extern HDC frameBufferDC;
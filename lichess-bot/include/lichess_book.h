@@ -0,0 +1,18 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lichess_game.h"
+#include "lichess_random.h"
+
+// Size of an entry in a Polyglot book file
+#define BOOK_ENTRY_SIZE 16
+
+bool openBook(const char *fileName);
+uint64_t polyglotKey(const GameState *state);
+uint16_t polyglotMove(uint16_t move, const GameState *state);
+uint16_t getBookMove(GameState *state, RngState *rng);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "lichess_nnue.h"
 #include "lichess_random.h"
 
 // Piece flags
@@ -38,22 +39,84 @@
 #define CASTLE_BLACK_KING 4
 #define CASTLE_BLACK_QUEEN 8
 
+// Most positions of game history a search looks at for repetitions
+#define MAX_GAME_HASHES 256
+
 typedef struct GameState
 {
+    uint64_t hash;
+    uint64_t pawnHash; // Zobrist hash of the pawns alone
+    int halfMoves; // Resets when a pawn is moved or a piece is captured.  Used for repetition detection.
     uint8_t playerToMove;
     uint8_t enPassantSquare;
     uint8_t castlingAvailablity;
     uint8_t board[64];
+    int middlegameScore; // Material and piece-square scores from white's side, kept up to date by movePiece
+    int endgameScore;
+    int phase;
+    NNUEAccumulator accumulator; // Only maintained while a network is loaded
 } GameState;
 
+typedef struct Zobrist
+{
+    uint64_t pieces[768];
+    uint64_t enPassantFile[8];
+    uint64_t playerToMove;
+    uint64_t blackQueenCastle;
+    uint64_t whiteQueenCastle;
+    uint64_t blackKingCastle;
+    uint64_t whiteKingCastle;
+} Zobrist;
+
+typedef struct TTEntry TTEntry;
+
+// A depth of 0 means the default depth
+typedef struct SearchLimits
+{
+    int depth;
+    uint64_t nodes; // 0 for no limit
+    uint64_t time; // Milliseconds, 0 for no limit
+    volatile bool *stop; // Set from another thread to abort the search
+    int variety; // Root moves scoring within this margin of the best move are picked at random
+    TTEntry *table; // Transposition table from newTranspositionTable, NULL for the shared one
+} SearchLimits;
+
+// A search running in the background on the position after the opponent's expected reply.
+typedef struct PonderSearch
+{
+    GameState state;
+    uint64_t history[MAX_GAME_HASHES];
+    int historyLength;
+    SearchLimits limits;
+    RngState rng;
+    void *thread;
+    volatile bool stop;
+    uint16_t move;
+    int score;
+} PonderSearch;
+
 enum GameEnd
 {
     GAME_NOT_OVER, CHECKMATE, STALEMATE, DRAW_50_MOVE, DRAW_REPITITION
 };
 
 void movePiece(uint16_t move, GameState *state);
+int getAllLegalMoves(uint16_t *moves, GameState *state);
+bool playerInCheck(GameState *state);
+enum GameEnd checkGameEnd(GameState *state, const uint64_t *history, int historyLength);
+void loadFenString(const char *str, GameState *state);
+void initZobrist(RngState *rng);
+void initSearch(void);
+void clearEvaluationCache(void);
 void initGameState(GameState *state);
-uint16_t getComputerMove(GameState *state, RngState *rng);
+uint16_t getComputerMove(GameState *state, const uint64_t *history, int historyLength, const SearchLimits *limits, RngState *rng, PonderSearch *ponder, int *score);
+void startPondering(PonderSearch *ponder, GameState *state, const uint64_t *history, int historyLength, const SearchLimits *limits, RngState *rng);
+void stopPondering(PonderSearch *ponder);
+void setSearchThreads(int threads);
+TTEntry *newTranspositionTable(void);
 void runTests(GameState *state, bool verbose);
+#ifdef TUNING
+int tuningEvaluation(GameState *state);
+#endif
 
 #endif
@@ -0,0 +1,24 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 768 piece-square inputs seen from each side, one hidden layer per side, one output.
+#define NNUE_INPUTS 768
+#define NNUE_HIDDEN 128
+
+// Hidden layer values for white's view [0] and black's view [1].  Kept up to date as pieces are added and removed.
+typedef struct NNUEAccumulator
+{
+    int16_t values[2][NNUE_HIDDEN];
+} NNUEAccumulator;
+
+bool loadNetwork(const char *fileName);
+bool networkLoaded(void);
+void resetAccumulator(NNUEAccumulator *accumulator);
+void addFeature(int cell, uint8_t piece, NNUEAccumulator *accumulator);
+void removeFeature(int cell, uint8_t piece, NNUEAccumulator *accumulator);
+int evaluateNetwork(const NNUEAccumulator *accumulator, uint8_t playerToMove);
+
+#endif
@@ -9,6 +9,7 @@ typedef struct RngState
     uint64_t inc;
 } RngState;
 
+uint64_t pcgGetRandom64(RngState *rng);
 uint32_t pcgRangedRandom(uint32_t range, RngState *rng);
 
 #endif
@@ -0,0 +1,175 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lichess_book.h"
+#include "lichess_polyglot.h"
+
+/* Opening books in the Polyglot format: 16 byte big-endian entries of key, move, weight and learn data,
+   sorted by key.  The file is mapped read-only and shared by every game thread. */
+
+#define KEY_CASTLE 768
+#define KEY_EN_PASSANT 772
+#define KEY_TURN 780
+
+// Polyglot's order of pieces is pawn, knight, bishop, rook, queen, king
+static const int pieceKinds[7] = {0, 0, 2, 1, 3, 4, 5};
+// Promotion pieces are numbered knight, bishop, rook, queen from 1
+static const int promotionCodes[7] = {0, 0, 2, 1, 3, 4, 0};
+
+static const uint8_t *book = NULL;
+static size_t numEntries = 0;
+
+bool openBook(const char *fileName)
+{
+    int file = open(fileName, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size < BOOK_ENTRY_SIZE)
+    {
+        close(file);
+        return false;
+    }
+    void *data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    book = data;
+    numEntries = fileStat.st_size / BOOK_ENTRY_SIZE;
+    return true;
+}
+
+static uint64_t readBigEndian(const uint8_t *data, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+// Squares are numbered from a1 in Polyglot and from a8 here, so flipping the rank converts between them
+static int polyglotSquare(int cell)
+{
+    return cell ^ 56;
+}
+
+uint64_t polyglotKey(const GameState *state)
+{
+    uint64_t key = 0;
+    for (int cell = 0; cell < 64; cell++)
+    {
+        uint8_t piece = state->board[cell];
+        if (piece != 0)
+        {
+            int kind = pieceKinds[piece & PIECE_TYPE_MASK] * 2 + ((piece & PIECE_OWNER_MASK) == WHITE);
+            key ^= polyglotRandom[64 * kind + polyglotSquare(cell)];
+        }
+    }
+    if (state->castlingAvailablity & CASTLE_WHITE_KING)
+    {
+        key ^= polyglotRandom[KEY_CASTLE];
+    }
+    if (state->castlingAvailablity & CASTLE_WHITE_QUEEN)
+    {
+        key ^= polyglotRandom[KEY_CASTLE + 1];
+    }
+    if (state->castlingAvailablity & CASTLE_BLACK_KING)
+    {
+        key ^= polyglotRandom[KEY_CASTLE + 2];
+    }
+    if (state->castlingAvailablity & CASTLE_BLACK_QUEEN)
+    {
+        key ^= polyglotRandom[KEY_CASTLE + 3];
+    }
+    // The en passant file only counts when a pawn could actually make the capture
+    if (state->enPassantSquare != 255)
+    {
+        int file = state->enPassantSquare % 8;
+        int pawnCell = state->playerToMove == WHITE ? state->enPassantSquare + 8 : state->enPassantSquare - 8;
+        uint8_t capturer = PAWN | state->playerToMove;
+        if ((file > 0 && state->board[pawnCell - 1] == capturer) || (file < 7 && state->board[pawnCell + 1] == capturer))
+        {
+            key ^= polyglotRandom[KEY_EN_PASSANT + file];
+        }
+    }
+    if (state->playerToMove == WHITE)
+    {
+        key ^= polyglotRandom[KEY_TURN];
+    }
+    return key;
+}
+
+// A move in Polyglot's encoding, where castling is the king capturing its own rook
+uint16_t polyglotMove(uint16_t move, const GameState *state)
+{
+    int moveTo = move & MOVE_TO_MASK;
+    int moveFrom = (move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
+    int pawnPromote = (move & PAWN_PROMOTE_MASK) >> PAWN_PROMOTE_SHIFT;
+    if ((move & CASTLE_ENPASSANT_FLAG) && (state->board[moveFrom] & PIECE_TYPE_MASK) == KING)
+    {
+        moveTo = moveTo > moveFrom ? moveTo + 1 : moveTo - 2;
+    }
+    return polyglotSquare(moveTo) | polyglotSquare(moveFrom) << 6 | promotionCodes[pawnPromote] << 12;
+}
+
+// Picks one of the book moves for the position with probability proportional to its weight.  Returns 0 when out of book.
+uint16_t getBookMove(GameState *state, RngState *rng)
+{
+    if (book == NULL)
+    {
+        return 0;
+    }
+    uint64_t key = polyglotKey(state);
+    size_t first = 0;
+    size_t last = numEntries;
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+        if (readBigEndian(book + middle * BOOK_ENTRY_SIZE, 8) < key)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+    uint32_t totalWeight = 0;
+    size_t end = first;
+    while (end < numEntries && readBigEndian(book + end * BOOK_ENTRY_SIZE, 8) == key)
+    {
+        totalWeight += readBigEndian(book + end * BOOK_ENTRY_SIZE + 10, 2);
+        end++;
+    }
+    if (totalWeight == 0)
+    {
+        return 0;
+    }
+    uint32_t pick = pcgRangedRandom(totalWeight, rng);
+    size_t entry = first;
+    uint32_t weight;
+    while ((weight = readBigEndian(book + entry * BOOK_ENTRY_SIZE + 10, 2)) <= pick)
+    {
+        pick -= weight;
+        entry++;
+    }
+    uint16_t bookMove = readBigEndian(book + entry * BOOK_ENTRY_SIZE + 8, 2);
+    uint16_t moves[1024];
+    int numMoves = getAllLegalMoves(moves, state);
+    for (int i = 0; i < numMoves; i++)
+    {
+        if (polyglotMove(moves[i], state) == bookMove)
+        {
+            return moves[i];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lichess_book.h"
+#include "lichess_game.h"
+
+/* Builds a Polyglot opening book from games given as lines of moves in UCI notation ("e2e4 e7e5 g1f3 ...").
+   Move numbers are skipped and a line ends at the first token that isn't a legal move, such as a result.
+   Each move played in the opening plies gets an entry weighted by how many games played it. */
+
+#define MAX_WEIGHT 65535
+
+typedef struct BookEntry
+{
+    uint64_t key;
+    uint16_t move;
+    uint32_t count;
+} BookEntry;
+
+static BookEntry *entries;
+static size_t numEntries;
+
+static void moveToString(uint16_t move, char *string)
+{
+    static const char promotions[7] = {0, 0, 'b', 'n', 'r', 'q', 0};
+    uint8_t moveTo = move & MOVE_TO_MASK;
+    uint8_t moveFrom = (move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
+    string[0] = 'a' + (moveFrom % 8);
+    string[1] = '8' - (moveFrom / 8);
+    string[2] = 'a' + (moveTo % 8);
+    string[3] = '8' - (moveTo / 8);
+    string[4] = promotions[(move & PAWN_PROMOTE_MASK) >> PAWN_PROMOTE_SHIFT];
+    string[5] = 0;
+}
+
+static bool addEntry(uint64_t key, uint16_t move)
+{
+    static size_t capacity = 0;
+    if (numEntries == capacity)
+    {
+        capacity = capacity > 0 ? capacity * 2 : 1 << 16;
+        BookEntry *newEntries = realloc(entries, capacity * sizeof(BookEntry));
+        if (newEntries == NULL)
+        {
+            puts("addEntry: realloc failed");
+            return false;
+        }
+        entries = newEntries;
+    }
+    entries[numEntries].key = key;
+    entries[numEntries].move = move;
+    entries[numEntries].count = 1;
+    numEntries++;
+    return true;
+}
+
+static bool loadGames(const char *fileName, int maxPlies, int *numGames)
+{
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL)
+    {
+        printf("Failed to open %s\n", fileName);
+        return false;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        GameState state;
+        initGameState(&state);
+        int ply = 0;
+        for (char *token = strtok(line, " \t\r\n"); token != NULL && ply < maxPlies; token = strtok(NULL, " \t\r\n"))
+        {
+            if (isdigit((unsigned char)token[0]) && token[strlen(token) - 1] == '.')
+            {
+                continue;
+            }
+            uint16_t moves[1024];
+            int numMoves = getAllLegalMoves(moves, &state);
+            int found = -1;
+            for (int i = 0; i < numMoves && found < 0; i++)
+            {
+                char moveString[6];
+                moveToString(moves[i], moveString);
+                if (strcmp(token, moveString) == 0)
+                {
+                    found = i;
+                }
+            }
+            if (found < 0)
+            {
+                break;
+            }
+            if (!addEntry(polyglotKey(&state), polyglotMove(moves[found], &state)))
+            {
+                fclose(file);
+                return false;
+            }
+            movePiece(moves[found], &state);
+            ply++;
+        }
+        if (ply > 0)
+        {
+            (*numGames)++;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static int compareMoves(const void *a, const void *b)
+{
+    const BookEntry *first = a;
+    const BookEntry *second = b;
+    if (first->key != second->key)
+    {
+        return first->key < second->key ? -1 : 1;
+    }
+    return (int)first->move - (int)second->move;
+}
+
+// Books are sorted by key, with the most played moves first
+static int compareWeights(const void *a, const void *b)
+{
+    const BookEntry *first = a;
+    const BookEntry *second = b;
+    if (first->key != second->key)
+    {
+        return first->key < second->key ? -1 : 1;
+    }
+    if (first->count != second->count)
+    {
+        return first->count > second->count ? -1 : 1;
+    }
+    return (int)first->move - (int)second->move;
+}
+
+static void writeBigEndian(uint8_t *data, uint64_t value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        data[i] = value & 255;
+        value >>= 8;
+    }
+}
+
+static bool writeBook(const char *fileName, int minCount, size_t *numWritten)
+{
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL)
+    {
+        printf("Failed to open %s\n", fileName);
+        return false;
+    }
+    *numWritten = 0;
+    for (size_t i = 0; i < numEntries; i++)
+    {
+        if (entries[i].count < (uint32_t)minCount)
+        {
+            continue;
+        }
+        uint8_t data[BOOK_ENTRY_SIZE];
+        memset(data, 0, BOOK_ENTRY_SIZE);
+        writeBigEndian(data, entries[i].key, 8);
+        writeBigEndian(data + 8, entries[i].move, 2);
+        writeBigEndian(data + 10, entries[i].count < MAX_WEIGHT ? entries[i].count : MAX_WEIGHT, 2);
+        if (fwrite(data, BOOK_ENTRY_SIZE, 1, file) != 1)
+        {
+            printf("Failed to write %s\n", fileName);
+            fclose(file);
+            return false;
+        }
+        (*numWritten)++;
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *gamesFile = NULL;
+    const char *output = "book.bin";
+    int maxPlies = 16;
+    int minCount = 1;
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-games") == 0)
+        {
+            gamesFile = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-plies") == 0)
+        {
+            maxPlies = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-min") == 0)
+        {
+            minCount = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-output") == 0)
+        {
+            output = argv[i + 1];
+        }
+    }
+    if (gamesFile == NULL)
+    {
+        puts("Usage: bookbuilder -games FILE [-plies N] [-min N] [-output FILE]");
+        return 1;
+    }
+    RngState zobristRng = {0x853C49E6748FEA9BULL, 0xDA3E39CB94B95BDBULL};
+    initZobrist(&zobristRng);
+    initSearch();
+    int numGames = 0;
+    if (!loadGames(gamesFile, maxPlies, &numGames))
+    {
+        return 1;
+    }
+    // Count each distinct position and move once, then order the moves of each position by how often they were played
+    qsort(entries, numEntries, sizeof(BookEntry), compareMoves);
+    size_t numDistinct = 0;
+    for (size_t i = 0; i < numEntries; i++)
+    {
+        if (numDistinct > 0 && entries[numDistinct - 1].key == entries[i].key && entries[numDistinct - 1].move == entries[i].move)
+        {
+            entries[numDistinct - 1].count++;
+        }
+        else
+        {
+            entries[numDistinct++] = entries[i];
+        }
+    }
+    numEntries = numDistinct;
+    qsort(entries, numEntries, sizeof(BookEntry), compareWeights);
+    size_t numWritten;
+    if (!writeBook(output, minCount, &numWritten))
+    {
+        return 1;
+    }
+    printf("Read %d games, wrote %zu entries to %s\n", numGames, numWritten, output);
+    return 0;
+}
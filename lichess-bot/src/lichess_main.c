@@ -1,6 +1,7 @@
 #include <curl/curl.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -12,6 +13,7 @@
 
 #include "lichess_random.h"
 #include "lichess_game.h"
+#include "lichess_book.h"
 
 typedef struct Buffer
 {
@@ -26,6 +28,8 @@ typedef struct IDBuffer
     size_t capacity;
     char *data;
     char id[8];
+    uint8_t color;
+    const struct StrengthLevel *level;
 } IDBuffer;
 
 typedef struct Challenge
@@ -38,6 +42,8 @@ typedef struct Challenge
 typedef struct GameStart
 {
     char id[8];
+    uint8_t color;
+    const struct StrengthLevel *level;
     struct GameStart *next;
 } GameStart;
 
@@ -46,9 +52,36 @@ typedef struct GameMoves
     struct GameMoves *next;
     size_t numMoves;
     char id[8];
+    uint8_t color;
+    const struct StrengthLevel *level;
     uint16_t moves[];
 } GameMoves;
 
+// Each game we're playing keeps its ponder search between moves, and a flag to stop its searches once it's over.
+typedef struct PonderGame
+{
+    pthread_mutex_t mutex;
+    char id[8];
+    volatile bool stop;
+    volatile bool over;
+    PonderSearch ponder;
+} PonderGame;
+
+#define MAX_PONDER_GAMES 64
+
+// Playing styles.  Moves scoring within variety centipawns of the best move are played at random.  Solid only varies between moves that tie the best.
+typedef struct Personality
+{
+    const char *name;
+    int variety;
+} Personality;
+
+static const Personality personalities[] =
+{
+    {"solid", 0},
+    {"playful", 50}
+};
+
 static pthread_mutex_t challengeMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t gameStartMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t gameMovesMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -65,6 +98,44 @@ static GameStart *gameStartQueueBack = NULL;
 static GameMoves *gameMovesQueueFront = NULL;
 static GameMoves *gameMovesQueueBack = NULL;
 
+static PonderGame ponderGames[MAX_PONDER_GAMES];
+static pthread_mutex_t ponderGamesMutex = PTHREAD_MUTEX_INITIALIZER;
+static int nextPonderGame = 0;
+
+// How much the bot searches per move.  Challengers are given the first level rated above them.
+typedef struct StrengthLevel
+{
+    const char *name;
+    int maxRating;
+    int depth;
+    uint64_t nodes;
+    uint64_t time;
+} StrengthLevel;
+
+static const StrengthLevel strengthLevels[] =
+{
+    {"beginner", 1200, 2, 5000, 200},
+    {"casual", 1600, 3, 50000, 1000},
+    {"club", 2000, 4, 500000, 5000},
+    {"full", INT_MAX, 0, 0, 0}
+};
+
+#define NUM_STRENGTH_LEVELS (sizeof(strengthLevels) / sizeof(StrengthLevel))
+#define MAX_CHALLENGE_LEVELS 64
+
+// Levels picked for accepted challenges, looked up by id when the game starts
+typedef struct ChallengeLevel
+{
+    char id[8];
+    const StrengthLevel *level;
+} ChallengeLevel;
+
+static const Personality *personality = &personalities[0];
+static const StrengthLevel *fixedLevel = NULL;
+static ChallengeLevel challengeLevels[MAX_CHALLENGE_LEVELS];
+static int nextChallengeLevel = 0;
+static pthread_mutex_t challengeLevelsMutex = PTHREAD_MUTEX_INITIALIZER;
+
 static char headerString[128];
 
 static bool seedRng(RngState *rng)
@@ -87,6 +158,48 @@ static bool seedRng(RngState *rng)
     return true;
 }
 
+static const StrengthLevel *levelForRating(int rating)
+{
+    if (fixedLevel != NULL)
+    {
+        return fixedLevel;
+    }
+    for (size_t i = 0; i < NUM_STRENGTH_LEVELS; i++)
+    {
+        if (rating < strengthLevels[i].maxRating)
+        {
+            return &strengthLevels[i];
+        }
+    }
+    return &strengthLevels[NUM_STRENGTH_LEVELS - 1];
+}
+
+static void rememberChallengeLevel(const char *id, const StrengthLevel *level)
+{
+    pthread_mutex_lock(&challengeLevelsMutex);
+    memcpy(challengeLevels[nextChallengeLevel].id, id, 8);
+    challengeLevels[nextChallengeLevel].level = level;
+    nextChallengeLevel = (nextChallengeLevel + 1) % MAX_CHALLENGE_LEVELS;
+    pthread_mutex_unlock(&challengeLevelsMutex);
+}
+
+// Games that didn't start from a challenge we saw get the strongest level.
+static const StrengthLevel *findChallengeLevel(const char *id)
+{
+    const StrengthLevel *level = levelForRating(INT_MAX);
+    pthread_mutex_lock(&challengeLevelsMutex);
+    for (int i = 0; i < MAX_CHALLENGE_LEVELS; i++)
+    {
+        if (challengeLevels[i].level != NULL && memcmp(challengeLevels[i].id, id, 8) == 0)
+        {
+            level = challengeLevels[i].level;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&challengeLevelsMutex);
+    return level;
+}
+
 size_t stubCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
     return size * nmemb;
@@ -137,6 +250,31 @@ size_t eventCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
                         challenge->accept = false;
                     }
                     memcpy(challenge->id, &writeBuffer->data[39], 8);
+                    if (challenge->accept)
+                    {
+                        int rating = INT_MAX;
+                        char *challenger = strstr(writeBuffer->data, "\"challenger\":{");
+                        // Only look inside the challenger object.  Unrated challengers would otherwise get our own rating.
+                        char *challengerEnd = challenger != NULL ? strchr(challenger, '}') : NULL;
+                        if (challengerEnd != NULL)
+                        {
+                            char *ratingString = strstr(challenger, "\"rating\":");
+                            if (ratingString != NULL && ratingString < challengerEnd)
+                            {
+                                rating = atoi(ratingString + strlen("\"rating\":"));
+                            }
+                        }
+                        const StrengthLevel *level = levelForRating(rating);
+                        if (rating == INT_MAX)
+                        {
+                            printf("Unrated challenger gets level %s\n", level->name);
+                        }
+                        else
+                        {
+                            printf("Challenger rated %d gets level %s\n", rating, level->name);
+                        }
+                        rememberChallengeLevel(challenge->id, level);
+                    }
                     challenge->next = NULL;
                     pthread_mutex_lock(&challengeMutex);
                     if (challengeQueueFront == NULL)
@@ -160,6 +298,15 @@ size_t eventCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
                         exit(1);
                     }
                     memcpy(gameStart->id, &writeBuffer->data[62], 8);
+                    gameStart->level = findChallengeLevel(gameStart->id);
+                    if (strstr(writeBuffer->data, "\"color\":\"black\"") != NULL)
+                    {
+                        gameStart->color = BLACK;
+                    }
+                    else
+                    {
+                        gameStart->color = WHITE;
+                    }
                     gameStart->next = NULL;
                     pthread_mutex_lock(&gameStartMutex);
                     if (gameStartQueueFront == NULL)
@@ -186,6 +333,23 @@ size_t eventCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
     return realSize;
 }
 
+// Stops any search for a game that has ended (mate, resign, abort, flag...) and ignores its later states.
+static void endGame(const char *id)
+{
+    pthread_mutex_lock(&ponderGamesMutex);
+    for (int i = 0; i < MAX_PONDER_GAMES; i++)
+    {
+        if (memcmp(ponderGames[i].id, id, 8) == 0)
+        {
+            ponderGames[i].over = true;
+            ponderGames[i].stop = true;
+            ponderGames[i].ponder.stop = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ponderGamesMutex);
+}
+
 size_t gameStartCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
     size_t realSize = size * nmemb;
@@ -214,7 +378,11 @@ size_t gameStartCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
                 writeBuffer->data[writeBuffer->size] = 0;
                 printf("%s\n\n", writeBuffer->data);
                 char *movesString = strstr(writeBuffer->data, movesCompareString);
-                if (movesString != NULL)
+                if (movesString != NULL && strstr(writeBuffer->data, "\"status\":\"started\"") == NULL && strstr(writeBuffer->data, "\"status\":\"created\"") == NULL)
+                {
+                    endGame(writeBuffer->id);
+                }
+                else if (movesString != NULL)
                 {
                     movesString += movesCompareStringLen;
                     char *movesPtr = movesString;
@@ -241,6 +409,8 @@ size_t gameStartCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
                     gameMoves->next = NULL;
                     gameMoves->numMoves = numMoves;
                     memcpy(gameMoves->id, writeBuffer->id, 8);
+                    gameMoves->color = writeBuffer->color;
+                    gameMoves->level = writeBuffer->level;
                     movesPtr = movesString;
                     for (size_t j = 0; j < numMoves; j++)
                     {
@@ -412,6 +582,8 @@ void *gameStartThreadLoop(void *arg)
         pthread_mutex_unlock(&gameStartMutex);
         memcpy(&url[urlStartLen], gameStart->id, 8);
         memcpy(writeBuffer.id, gameStart->id, 8);
+        writeBuffer.color = gameStart->color;
+        writeBuffer.level = gameStart->level;
         free(gameStart);
         curl_easy_setopt(curl, CURLOPT_URL, url);
         if (curl_easy_perform(curl) != CURLE_OK)
@@ -422,6 +594,39 @@ void *gameStartThreadLoop(void *arg)
     return NULL;
 }
 
+// Returns the game's ponder slot locked, taking over the oldest slot for a new game.
+static PonderGame *lockPonderGame(const char *id)
+{
+    while (true)
+    {
+        pthread_mutex_lock(&ponderGamesMutex);
+        PonderGame *game = NULL;
+        for (int i = 0; i < MAX_PONDER_GAMES; i++)
+        {
+            if (memcmp(ponderGames[i].id, id, 8) == 0)
+            {
+                game = &ponderGames[i];
+                break;
+            }
+        }
+        if (game == NULL)
+        {
+            game = &ponderGames[nextPonderGame];
+            nextPonderGame = (nextPonderGame + 1) % MAX_PONDER_GAMES;
+            memcpy(game->id, id, 8);
+            game->over = false;
+        }
+        pthread_mutex_unlock(&ponderGamesMutex);
+        pthread_mutex_lock(&game->mutex);
+        // Another game may have taken the slot before we locked it.
+        if (memcmp(game->id, id, 8) == 0)
+        {
+            return game;
+        }
+        pthread_mutex_unlock(&game->mutex);
+    }
+}
+
 void *makeMoveThreadLoop(void *arg)
 {
     RngState rng;
@@ -475,8 +680,16 @@ void *makeMoveThreadLoop(void *arg)
         memcpy(&url[urlStartLen], gameMoves->id, 8);
         GameState state;
         initGameState(&state);
+        // Hashes of the positions before the current one, for repetition detection.
+        uint64_t *history = malloc((gameMoves->numMoves + 1) * sizeof(uint64_t));
+        if (history == NULL)
+        {
+            puts("malloc failed");
+            exit(1);
+        }
         for (size_t i = 0; i < gameMoves->numMoves; i++)
         {
+            history[i] = state.hash;
             uint16_t move = gameMoves->moves[i];
             uint8_t moveTo = move & MOVE_TO_MASK;
             uint8_t moveFrom = (move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
@@ -498,8 +711,39 @@ void *makeMoveThreadLoop(void *arg)
             }
             movePiece(move, &state);
         }
+        PonderGame *game = lockPonderGame(gameMoves->id);
+        game->stop = false;
+        if (game->over)
+        {
+            pthread_mutex_unlock(&game->mutex);
+            free(history);
+            free(gameMoves);
+            continue;
+        }
+        const StrengthLevel *level = gameMoves->level;
+        SearchLimits limits = {level->depth, level->nodes, level->time, &game->stop, personality->variety};
+        if (state.playerToMove != gameMoves->color)
+        {
+            // Our own move coming back from the stream.  Think on the opponent's time.
+            startPondering(&game->ponder, &state, history, gameMoves->numMoves, &limits, &rng);
+            pthread_mutex_unlock(&game->mutex);
+            free(history);
+            free(gameMoves);
+            continue;
+        }
+        // Book moves are played straight away without a search
+        uint16_t computerMove = getBookMove(&state, &rng);
+        if (computerMove != 0)
+        {
+            stopPondering(&game->ponder);
+        }
+        else
+        {
+            computerMove = getComputerMove(&state, history, gameMoves->numMoves, &limits, &rng, &game->ponder, NULL);
+        }
+        pthread_mutex_unlock(&game->mutex);
+        free(history);
         free(gameMoves);
-        uint16_t computerMove = getComputerMove(&state, &rng);
         uint8_t computerMoveTo = computerMove & MOVE_TO_MASK;
         uint8_t computerMoveFrom = (computerMove & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
         uint8_t pawnPromote = (computerMove & PAWN_PROMOTE_MASK) >> PAWN_PROMOTE_SHIFT;
@@ -592,7 +836,7 @@ static bool generateHeaderString(void)
     return true;
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
     if (curl_global_init(CURL_GLOBAL_ALL) != CURLE_OK)
     {
@@ -604,6 +848,79 @@ int main(void)
         puts("Failed to generate authentication header");
         return 1;
     }
+    RngState zobristRng;
+    if (!seedRng(&zobristRng))
+    {
+        puts("Failed to seed RNG");
+        return 1;
+    }
+    initZobrist(&zobristRng);
+    initSearch();
+    for (int i = 0; i < MAX_PONDER_GAMES; i++)
+    {
+        pthread_mutex_init(&ponderGames[i].mutex, NULL);
+    }
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-threads") == 0)
+        {
+            setSearchThreads(atoi(argv[i + 1]));
+        }
+        else if (strcmp(argv[i], "-nnue") == 0)
+        {
+            if (loadNetwork(argv[i + 1]))
+            {
+                printf("Loaded network %s\n", argv[i + 1]);
+            }
+            else
+            {
+                printf("Failed to load network %s, using the classical evaluation\n", argv[i + 1]);
+            }
+        }
+        else if (strcmp(argv[i], "-book") == 0)
+        {
+            if (openBook(argv[i + 1]))
+            {
+                printf("Loaded book %s\n", argv[i + 1]);
+            }
+            else
+            {
+                printf("Failed to load book %s\n", argv[i + 1]);
+            }
+        }
+        else if (strcmp(argv[i], "-personality") == 0)
+        {
+            bool found = false;
+            for (size_t j = 0; j < sizeof(personalities) / sizeof(Personality); j++)
+            {
+                if (strcmp(argv[i + 1], personalities[j].name) == 0)
+                {
+                    personality = &personalities[j];
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                printf("Unknown personality: %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-level") == 0)
+        {
+            for (size_t j = 0; j < NUM_STRENGTH_LEVELS; j++)
+            {
+                if (strcmp(argv[i + 1], strengthLevels[j].name) == 0)
+                {
+                    fixedLevel = &strengthLevels[j];
+                }
+            }
+            if (fixedLevel == NULL)
+            {
+                printf("Unknown level: %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+    }
     pthread_t thread;
     if (pthread_create(&thread, NULL, challengeThreadLoop, NULL) != 0)
     {
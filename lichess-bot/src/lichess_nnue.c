@@ -0,0 +1,197 @@
+#include "lichess_nnue.h"
+#include "lichess_game.h"
+
+#include <stdio.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Network file layout, all little endian:
+   uint32 magic, uint32 version, uint32 hidden size,
+   int16 feature weights [768][hidden], int16 feature biases [hidden],
+   int16 output weights [2][hidden] (side to move first), int32 output bias.
+   Hidden values are clipped to 0..NNUE_QA.  Output weights are scaled by NNUE_QB. */
+#define NNUE_MAGIC 0x45554E4E // "NNUE"
+#define NNUE_VERSION 1
+#define NNUE_QA 255
+#define NNUE_QB 64
+#define NNUE_SCALE 400 // Centipawns per unit of network output
+#define NNUE_MAX_EVALUATION 20000 // Keeps a bad network clear of mate scores
+
+typedef struct Network
+{
+    int16_t featureWeights[NNUE_INPUTS][NNUE_HIDDEN];
+    int16_t featureBiases[NNUE_HIDDEN];
+    int16_t outputWeights[2][NNUE_HIDDEN];
+    int32_t outputBias;
+} Network;
+
+static Network network;
+static bool loaded = false;
+
+// Pieces are ordered pawn, knight, bishop, rook, queen, king.  Squares count from a1 on the viewing side.
+static const int featurePieceOrder[7] = {0, 0, 2, 1, 3, 4, 5};
+
+static int featureIndex(int perspective, int cell, uint8_t piece)
+{
+    int owner = (piece & PIECE_OWNER_MASK) == WHITE ? 0 : 1;
+    int square = perspective == 0 ? cell ^ 56 : cell;
+    return (owner == perspective ? 0 : 384) + featurePieceOrder[piece & PIECE_TYPE_MASK] * 64 + square;
+}
+
+static bool readValues(void *values, size_t size, size_t count, FILE *file)
+{
+    return fread(values, size, count, file) == count;
+}
+
+// Must not be called during a search.  Whatever happens the evaluation may change, so cached scores are dropped.
+bool loadNetwork(const char *fileName)
+{
+    loaded = false;
+    clearEvaluationCache();
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    uint32_t header[3];
+    bool success = readValues(header, sizeof(uint32_t), 3, file)
+        && header[0] == NNUE_MAGIC && header[1] == NNUE_VERSION && header[2] == NNUE_HIDDEN
+        && readValues(network.featureWeights, sizeof(int16_t), NNUE_INPUTS * NNUE_HIDDEN, file)
+        && readValues(network.featureBiases, sizeof(int16_t), NNUE_HIDDEN, file)
+        && readValues(network.outputWeights, sizeof(int16_t), 2 * NNUE_HIDDEN, file)
+        && readValues(&network.outputBias, sizeof(int32_t), 1, file);
+    fclose(file);
+    loaded = success;
+    return success;
+}
+
+bool networkLoaded(void)
+{
+    return loaded;
+}
+
+static void addWeights(int16_t *values, const int16_t *weights)
+{
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16)
+    {
+        __m256i sum = _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)&values[i]), _mm256_loadu_si256((const __m256i *)&weights[i]));
+        _mm256_storeu_si256((__m256i *)&values[i], sum);
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8)
+    {
+        __m128i sum = _mm_add_epi16(_mm_loadu_si128((const __m128i *)&values[i]), _mm_loadu_si128((const __m128i *)&weights[i]));
+        _mm_storeu_si128((__m128i *)&values[i], sum);
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+    {
+        values[i] += weights[i];
+    }
+#endif
+}
+
+static void subtractWeights(int16_t *values, const int16_t *weights)
+{
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16)
+    {
+        __m256i difference = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *)&values[i]), _mm256_loadu_si256((const __m256i *)&weights[i]));
+        _mm256_storeu_si256((__m256i *)&values[i], difference);
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8)
+    {
+        __m128i difference = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)&values[i]), _mm_loadu_si128((const __m128i *)&weights[i]));
+        _mm_storeu_si128((__m128i *)&values[i], difference);
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+    {
+        values[i] -= weights[i];
+    }
+#endif
+}
+
+// Sum of hidden values clipped to 0..NNUE_QA times the output weights.
+static int32_t clippedDotProduct(const int16_t *values, const int16_t *weights)
+{
+#if defined(__AVX2__)
+    __m256i zero = _mm256_setzero_si256();
+    __m256i limit = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < NNUE_HIDDEN; i += 16)
+    {
+        __m256i clipped = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i *)&values[i]), zero), limit);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(clipped, _mm256_loadu_si256((const __m256i *)&weights[i])));
+    }
+    __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1, 0, 3, 2)));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(total);
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i limit = _mm_set1_epi16(NNUE_QA);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < NNUE_HIDDEN; i += 8)
+    {
+        __m128i clipped = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)&values[i]), zero), limit);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(clipped, _mm_loadu_si128((const __m128i *)&weights[i])));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+    {
+        int16_t clipped = values[i] < 0 ? 0 : (values[i] > NNUE_QA ? NNUE_QA : values[i]);
+        sum += clipped * weights[i];
+    }
+    return sum;
+#endif
+}
+
+void resetAccumulator(NNUEAccumulator *accumulator)
+{
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+    {
+        accumulator->values[0][i] = network.featureBiases[i];
+        accumulator->values[1][i] = network.featureBiases[i];
+    }
+}
+
+void addFeature(int cell, uint8_t piece, NNUEAccumulator *accumulator)
+{
+    addWeights(accumulator->values[0], network.featureWeights[featureIndex(0, cell, piece)]);
+    addWeights(accumulator->values[1], network.featureWeights[featureIndex(1, cell, piece)]);
+}
+
+void removeFeature(int cell, uint8_t piece, NNUEAccumulator *accumulator)
+{
+    subtractWeights(accumulator->values[0], network.featureWeights[featureIndex(0, cell, piece)]);
+    subtractWeights(accumulator->values[1], network.featureWeights[featureIndex(1, cell, piece)]);
+}
+
+// Evaluation in centipawns for the side to move.
+int evaluateNetwork(const NNUEAccumulator *accumulator, uint8_t playerToMove)
+{
+    int us = playerToMove == WHITE ? 0 : 1;
+    int64_t output = (int64_t)clippedDotProduct(accumulator->values[us], network.outputWeights[0])
+        + clippedDotProduct(accumulator->values[1 - us], network.outputWeights[1]) + network.outputBias;
+    int evaluation = (int)(output * NNUE_SCALE / (NNUE_QA * NNUE_QB));
+    if (evaluation > NNUE_MAX_EVALUATION)
+    {
+        return NNUE_MAX_EVALUATION;
+    }
+    if (evaluation < -NNUE_MAX_EVALUATION)
+    {
+        return -NNUE_MAX_EVALUATION;
+    }
+    return evaluation;
+}
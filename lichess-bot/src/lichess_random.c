@@ -9,6 +9,13 @@ static uint32_t pcgGetRandom(RngState *rng)
     return (xorshifted >> rot) | (xorshifted << ((0 - rot) & 31));
 }
 
+uint64_t pcgGetRandom64(RngState *rng)
+{
+    uint64_t randomHigh = pcgGetRandom(rng);
+    uint64_t randomLow = pcgGetRandom(rng);
+    return (randomHigh << 32) | randomLow;
+}
+
 uint32_t pcgRangedRandom(uint32_t range, RngState *rng)
 {
     uint32_t x = pcgGetRandom(rng);
@@ -0,0 +1,695 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lichess_random.h"
+#include "lichess_game.h"
+
+#define MAX_WORKERS 64
+#define MAX_GAME_PLIES 600 // Drawn if reached
+#define RANDOM_OPENING_PLIES 4 // Used when no opening suite is given
+#define TIMED_DEPTH 63 // Timed engines search as deep as the engine allows
+#define MOVE_OVERHEAD 20 // Milliseconds kept back for time the search doesn't see
+// Adjudication.  Scores are in centipawns from the search of the side that just moved.
+#define DRAW_MIN_PLIES 80
+#define DRAW_SCORE 10
+#define DRAW_PLIES 10
+#define RESIGN_SCORE 1000
+#define RESIGN_PLIES 6
+// Positions saved for tuning
+#define MAX_FEN_LENGTH 96
+#define POSITIONS_MIN_PLIES 8 // Skips the opening
+
+typedef struct EngineConfig
+{
+    char name[32];
+    int depth;
+    uint64_t nodes;
+    uint64_t moveTime; // Fixed milliseconds per move, overrides the clock
+    uint64_t baseTime; // Milliseconds on the clock at the start, 0 for no clock
+    uint64_t increment; // Milliseconds added after each move
+    int variety;
+    TTEntry *table; // Each side has its own so neither sees the other's search results
+} EngineConfig;
+
+typedef struct Tournament
+{
+    EngineConfig engines[2];
+    char **openings;
+    int numOpenings;
+    int numGames;
+    int nextGame;
+    // Results from the first engine's side
+    int wins;
+    int losses;
+    int draws;
+    double elo0;
+    double elo1;
+    double alpha;
+    double beta;
+    uint64_t seed;
+    FILE *positionsFile; // Quiet positions labelled with the game result, NULL if not saving them
+    volatile bool stop;
+    pthread_mutex_t mutex;
+} Tournament;
+
+static Tournament tournament;
+
+static bool seedRng(RngState *rng)
+{
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd == -1)
+    {
+        printf("Failed to open /dev/urandom: %s\n", strerror(errno));
+        return false;
+    }
+    uint64_t randomBuffer[2];
+    if (read(fd, randomBuffer, 16) != 16)
+    {
+        close(fd);
+        return false;
+    }
+    rng->state = randomBuffer[0];
+    rng->inc = randomBuffer[1] | 1;
+    close(fd);
+    return true;
+}
+
+static uint64_t getTime(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+
+/* Parses an engine description such as "name=new tc=10+0.1" or "name=base depth=5 nodes=20000".
+   Keys are name, depth, nodes, movetime (milliseconds), tc (seconds plus increment) and variety. */
+static bool parseEngineConfig(const char *description, EngineConfig *engine)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", description);
+    bool timeControl = false;
+    for (char *token = strtok(buffer, " "); token != NULL; token = strtok(NULL, " "))
+    {
+        char *value = strchr(token, '=');
+        if (value == NULL)
+        {
+            printf("Bad engine option: %s\n", token);
+            return false;
+        }
+        *value++ = 0;
+        if (strcmp(token, "name") == 0)
+        {
+            snprintf(engine->name, sizeof(engine->name), "%s", value);
+        }
+        else if (strcmp(token, "depth") == 0)
+        {
+            engine->depth = atoi(value);
+        }
+        else if (strcmp(token, "nodes") == 0)
+        {
+            engine->nodes = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "movetime") == 0)
+        {
+            engine->moveTime = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "tc") == 0)
+        {
+            timeControl = true;
+            char *increment = strchr(value, '+');
+            engine->baseTime = (uint64_t)(atof(value) * 1000);
+            engine->increment = increment != NULL ? (uint64_t)(atof(increment + 1) * 1000) : 0;
+        }
+        else if (strcmp(token, "variety") == 0)
+        {
+            engine->variety = atoi(value);
+        }
+        else
+        {
+            printf("Unknown engine option: %s\n", token);
+            return false;
+        }
+    }
+    // The default clock only applies to engines without limits of their own.
+    if (!timeControl && (engine->depth > 0 || engine->nodes > 0 || engine->moveTime > 0))
+    {
+        engine->baseTime = 0;
+        engine->increment = 0;
+    }
+    if (engine->depth == 0 && (engine->moveTime > 0 || engine->baseTime > 0))
+    {
+        engine->depth = TIMED_DEPTH;
+    }
+    return true;
+}
+
+// One FEN or EPD position per line.  EPD lines get a move counter so they load as FEN.
+static bool loadOpenings(const char *fileName)
+{
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL)
+    {
+        printf("Failed to open %s\n", fileName);
+        return false;
+    }
+    char line[256];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        int fields = 0;
+        size_t length = 0;
+        for (char *c = line; *c != 0; c++)
+        {
+            if (*c != ' ' && (c == line || c[-1] == ' '))
+            {
+                fields++;
+                // EPD operations start at the fifth field
+                if (fields == 5 && !(*c >= '0' && *c <= '9'))
+                {
+                    break;
+                }
+            }
+            length = c - line + 1;
+        }
+        if (fields < 4)
+        {
+            continue;
+        }
+        line[length] = 0;
+        while (length > 0 && line[length - 1] == ' ')
+        {
+            line[--length] = 0;
+        }
+        if (tournament.numOpenings == capacity)
+        {
+            capacity = capacity > 0 ? capacity * 2 : 256;
+            char **newOpenings = realloc(tournament.openings, capacity * sizeof(char *));
+            if (newOpenings == NULL)
+            {
+                puts("loadOpenings: realloc failed");
+                fclose(file);
+                return false;
+            }
+            tournament.openings = newOpenings;
+        }
+        char *opening = malloc(length + 8);
+        if (opening == NULL)
+        {
+            puts("loadOpenings: malloc failed");
+            fclose(file);
+            return false;
+        }
+        snprintf(opening, length + 8, fields >= 6 ? "%s" : "%s 0 1", line);
+        tournament.openings[tournament.numOpenings++] = opening;
+    }
+    fclose(file);
+    return tournament.numOpenings > 0;
+}
+
+// Both games of a pair start from the same position with colours swapped.
+static void setUpOpening(int pair, GameState *state)
+{
+    if (tournament.numOpenings > 0)
+    {
+        loadFenString(tournament.openings[pair % tournament.numOpenings], state);
+        return;
+    }
+    RngState rng = {tournament.seed + pair, (tournament.seed ^ (uint64_t)pair << 1) | 1};
+    uint64_t history[RANDOM_OPENING_PLIES];
+    do
+    {
+        initGameState(state);
+        for (int ply = 0; ply < RANDOM_OPENING_PLIES; ply++)
+        {
+            uint16_t moves[1024];
+            int numMoves = getAllLegalMoves(moves, state);
+            if (numMoves == 0)
+            {
+                break;
+            }
+            history[ply] = state->hash;
+            movePiece(moves[pcgRangedRandom(numMoves, &rng)], state);
+        }
+    } while (checkGameEnd(state, history, RANDOM_OPENING_PLIES) != GAME_NOT_OVER);
+}
+
+static bool insufficientMaterial(GameState *state)
+{
+    int minorPieces = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        uint8_t pieceType = state->board[i] & PIECE_TYPE_MASK;
+        if (pieceType == PAWN || pieceType == ROOK || pieceType == QUEEN)
+        {
+            return false;
+        }
+        if (pieceType == BISHOP || pieceType == KNIGHT)
+        {
+            minorPieces++;
+        }
+    }
+    return minorPieces <= 1;
+}
+
+static void writeFen(GameState *state, int fullMoves, char *fen)
+{
+    static const char pieceLetters[7] = {0, 'p', 'b', 'n', 'r', 'q', 'k'};
+    int length = 0;
+    for (int row = 0; row < 8; row++)
+    {
+        int empty = 0;
+        for (int col = 0; col < 8; col++)
+        {
+            uint8_t piece = state->board[row * 8 + col];
+            if (piece == 0)
+            {
+                empty++;
+                continue;
+            }
+            if (empty > 0)
+            {
+                fen[length++] = '0' + empty;
+                empty = 0;
+            }
+            char letter = pieceLetters[piece & PIECE_TYPE_MASK];
+            fen[length++] = (piece & PIECE_OWNER_MASK) == WHITE ? letter - 'a' + 'A' : letter;
+        }
+        if (empty > 0)
+        {
+            fen[length++] = '0' + empty;
+        }
+        fen[length++] = row < 7 ? '/' : ' ';
+    }
+    fen[length++] = state->playerToMove == WHITE ? 'w' : 'b';
+    fen[length++] = ' ';
+    int castlingStart = length;
+    if (state->castlingAvailablity & CASTLE_WHITE_KING)
+    {
+        fen[length++] = 'K';
+    }
+    if (state->castlingAvailablity & CASTLE_WHITE_QUEEN)
+    {
+        fen[length++] = 'Q';
+    }
+    if (state->castlingAvailablity & CASTLE_BLACK_KING)
+    {
+        fen[length++] = 'k';
+    }
+    if (state->castlingAvailablity & CASTLE_BLACK_QUEEN)
+    {
+        fen[length++] = 'q';
+    }
+    if (length == castlingStart)
+    {
+        fen[length++] = '-';
+    }
+    // En passant is left out.  It doesn't change the evaluation.
+    snprintf(fen + length, MAX_FEN_LENGTH - length, " - %d %d", state->halfMoves, fullMoves);
+}
+
+// Quiet positions have no capture or promotion about to happen and the side to move isn't in check.
+static bool isQuietPosition(uint16_t move, GameState *state)
+{
+    return state->board[move & MOVE_TO_MASK] == 0 && (move & (PAWN_PROMOTE_MASK | CASTLE_ENPASSANT_FLAG)) == 0
+        && !playerInCheck(state);
+}
+
+// Time for the next move: a share of the clock plus most of the increment.
+static uint64_t moveTimeBudget(const EngineConfig *engine, uint64_t clock)
+{
+    if (engine->moveTime > 0)
+    {
+        return engine->moveTime;
+    }
+    if (engine->baseTime == 0)
+    {
+        return 0;
+    }
+    uint64_t available = clock > MOVE_OVERHEAD ? clock - MOVE_OVERHEAD : 0;
+    uint64_t budget = available / 20 + engine->increment * 3 / 4;
+    if (budget > available / 2)
+    {
+        budget = available / 2;
+    }
+    return budget > 0 ? budget : 1;
+}
+
+/* Plays one game and returns 1 if the first engine won, -1 if it lost and 0 for a draw.
+   The first engine has white in even games.  Quiet positions are saved to positions when it isn't NULL. */
+static int playGame(int game, RngState *rng, const char **reason, char (*positions)[MAX_FEN_LENGTH], int *numPositions)
+{
+    GameState state;
+    setUpOpening(game / 2, &state);
+    int whiteEngine = game % 2;
+    uint64_t clocks[2] = {tournament.engines[0].baseTime, tournament.engines[1].baseTime};
+    uint64_t history[MAX_GAME_PLIES];
+    int drawPlies = 0;
+    int resignPlies = 0;
+    int winner = 0;
+    *numPositions = 0;
+    for (int ply = 0; ; ply++)
+    {
+        int engineToMove = state.playerToMove == WHITE ? whiteEngine : 1 - whiteEngine;
+        enum GameEnd end = checkGameEnd(&state, history, ply);
+        if (end == CHECKMATE)
+        {
+            *reason = "checkmate";
+            return engineToMove == 0 ? -1 : 1;
+        }
+        if (end != GAME_NOT_OVER)
+        {
+            *reason = end == STALEMATE ? "stalemate" : end == DRAW_50_MOVE ? "50 move rule" : "repetition";
+            return 0;
+        }
+        if (insufficientMaterial(&state))
+        {
+            *reason = "insufficient material";
+            return 0;
+        }
+        if (ply == MAX_GAME_PLIES)
+        {
+            *reason = "maximum length";
+            return 0;
+        }
+        // Games still running when the SPRT finishes are dropped.
+        if (tournament.stop)
+        {
+            *reason = "aborted";
+            return 0;
+        }
+        const EngineConfig *engine = &tournament.engines[engineToMove];
+        SearchLimits limits = {engine->depth, engine->nodes, moveTimeBudget(engine, clocks[engineToMove]), NULL, engine->variety, engine->table};
+        int score;
+        uint64_t startTime = getTime();
+        uint16_t move = getComputerMove(&state, history, ply, &limits, rng, NULL, &score);
+        uint64_t elapsed = getTime() - startTime;
+        if (engine->baseTime > 0)
+        {
+            if (elapsed > clocks[engineToMove])
+            {
+                *reason = "time forfeit";
+                return engineToMove == 0 ? -1 : 1;
+            }
+            clocks[engineToMove] += engine->increment - elapsed;
+        }
+        if (positions != NULL && ply >= POSITIONS_MIN_PLIES && abs(score) < RESIGN_SCORE && isQuietPosition(move, &state))
+        {
+            writeFen(&state, ply / 2 + 1, positions[(*numPositions)++]);
+        }
+        history[ply] = state.hash;
+        movePiece(move, &state);
+        // Adjudicate once the searches agree the game is decided or dead drawn.
+        int firstEngineScore = engineToMove == 0 ? score : -score;
+        if (abs(score) >= RESIGN_SCORE && (resignPlies == 0 || (firstEngineScore > 0) == (winner > 0)))
+        {
+            resignPlies++;
+            winner = firstEngineScore > 0 ? 1 : -1;
+        }
+        else
+        {
+            resignPlies = 0;
+        }
+        if (resignPlies >= RESIGN_PLIES)
+        {
+            *reason = "adjudicated win";
+            return winner;
+        }
+        drawPlies = ply >= DRAW_MIN_PLIES && abs(score) <= DRAW_SCORE ? drawPlies + 1 : 0;
+        if (drawPlies >= DRAW_PLIES)
+        {
+            *reason = "adjudicated draw";
+            return 0;
+        }
+    }
+}
+
+static double scoreToElo(double score)
+{
+    if (score <= 0.0)
+    {
+        score = 1e-6;
+    }
+    if (score >= 1.0)
+    {
+        score = 1.0 - 1e-6;
+    }
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+static double eloToScore(double elo)
+{
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+/* Sequential probability ratio test on the game results, using the normal approximation
+   to the log likelihood ratio of H1 (elo1) against H0 (elo0). */
+static double logLikelihoodRatio(void)
+{
+    int games = tournament.wins + tournament.losses + tournament.draws;
+    if (games == 0)
+    {
+        return 0.0;
+    }
+    double score = (tournament.wins + tournament.draws / 2.0) / games;
+    double variance = (tournament.wins + tournament.draws / 4.0) / games - score * score;
+    if (variance <= 0.0)
+    {
+        return 0.0;
+    }
+    double score0 = eloToScore(tournament.elo0);
+    double score1 = eloToScore(tournament.elo1);
+    return games * (score1 - score0) * (2.0 * score - score0 - score1) / (2.0 * variance);
+}
+
+// Called with the mutex held.  Returns true once the SPRT reaches a verdict.
+static bool printStatus(void)
+{
+    int games = tournament.wins + tournament.losses + tournament.draws;
+    double score = (tournament.wins + tournament.draws / 2.0) / games;
+    double variance = (tournament.wins + tournament.draws / 4.0) / games - score * score;
+    double margin = 1.96 * sqrt(variance > 0.0 ? variance / games : 0.0);
+    double elo = scoreToElo(score);
+    // Slope of the Elo curve at the measured score
+    double eloMargin = score > 0.0 && score < 1.0 ? margin * 400.0 / (log(10.0) * score * (1.0 - score)) : 0.0;
+    double llr = logLikelihoodRatio();
+    double lowerBound = log(tournament.beta / (1.0 - tournament.alpha));
+    double upperBound = log((1.0 - tournament.beta) / tournament.alpha);
+    printf("Score of %s vs %s: %d - %d - %d [%.3f] %d\n", tournament.engines[0].name, tournament.engines[1].name,
+        tournament.wins, tournament.losses, tournament.draws, score, games);
+    printf("Elo difference: %.1f +/- %.1f, LLR: %.2f (%.2f, %.2f) [%.1f, %.1f]\n",
+        elo, eloMargin, llr, lowerBound, upperBound, tournament.elo0, tournament.elo1);
+    if (llr >= upperBound)
+    {
+        puts("SPRT: H1 accepted");
+        return true;
+    }
+    if (llr <= lowerBound)
+    {
+        puts("SPRT: H0 accepted");
+        return true;
+    }
+    return false;
+}
+
+static void *workerThread(void *arg)
+{
+    RngState *rng = arg;
+    char (*positions)[MAX_FEN_LENGTH] = NULL;
+    if (tournament.positionsFile != NULL)
+    {
+        positions = malloc(MAX_GAME_PLIES * sizeof(*positions));
+        if (positions == NULL)
+        {
+            puts("workerThread: malloc failed");
+            return NULL;
+        }
+    }
+    for (;;)
+    {
+        pthread_mutex_lock(&tournament.mutex);
+        if (tournament.stop || tournament.nextGame >= tournament.numGames)
+        {
+            pthread_mutex_unlock(&tournament.mutex);
+            free(positions);
+            return NULL;
+        }
+        int game = tournament.nextGame++;
+        pthread_mutex_unlock(&tournament.mutex);
+        const char *reason;
+        int numPositions;
+        int result = playGame(game, rng, &reason, positions, &numPositions);
+        pthread_mutex_lock(&tournament.mutex);
+        if (strcmp(reason, "aborted") != 0)
+        {
+            if (result > 0)
+            {
+                tournament.wins++;
+            }
+            else if (result < 0)
+            {
+                tournament.losses++;
+            }
+            else
+            {
+                tournament.draws++;
+            }
+            const char *white = tournament.engines[game % 2].name;
+            const char *black = tournament.engines[1 - game % 2].name;
+            int whiteResult = game % 2 == 0 ? result : -result;
+            for (int i = 0; i < numPositions; i++)
+            {
+                fprintf(tournament.positionsFile, "%s [%s]\n", positions[i], whiteResult > 0 ? "1.0" : whiteResult < 0 ? "0.0" : "0.5");
+            }
+            printf("Game %d: %s vs %s %s (%s)\n", game + 1, white, black,
+                whiteResult > 0 ? "1-0" : whiteResult < 0 ? "0-1" : "1/2-1/2", reason);
+            if (printStatus())
+            {
+                tournament.stop = true;
+            }
+        }
+        pthread_mutex_unlock(&tournament.mutex);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    RngState rng;
+    if (!seedRng(&rng))
+    {
+        puts("Failed to seed RNG");
+        return 1;
+    }
+    initZobrist(&rng);
+    initSearch();
+    int numEngines = 0;
+    int concurrency = 1;
+    tournament.numGames = 1000;
+    tournament.elo0 = 0.0;
+    tournament.elo1 = 5.0;
+    tournament.alpha = 0.05;
+    tournament.beta = 0.05;
+    tournament.seed = pcgGetRandom64(&rng);
+    for (int i = 0; i < 2; i++)
+    {
+        snprintf(tournament.engines[i].name, sizeof(tournament.engines[i].name), "engine%d", i + 1);
+        tournament.engines[i].baseTime = 10000;
+        tournament.engines[i].increment = 100;
+    }
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-engine") == 0)
+        {
+            if (numEngines == 2)
+            {
+                puts("Only two engines can play");
+                return 1;
+            }
+            EngineConfig *engine = &tournament.engines[numEngines++];
+            if (!parseEngineConfig(argv[i + 1], engine))
+            {
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-openings") == 0)
+        {
+            if (!loadOpenings(argv[i + 1]))
+            {
+                printf("No openings loaded from %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-games") == 0)
+        {
+            tournament.numGames = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-concurrency") == 0)
+        {
+            concurrency = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-elo0") == 0)
+        {
+            tournament.elo0 = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-elo1") == 0)
+        {
+            tournament.elo1 = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-alpha") == 0)
+        {
+            tournament.alpha = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-beta") == 0)
+        {
+            tournament.beta = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-positions") == 0)
+        {
+            tournament.positionsFile = fopen(argv[i + 1], "a");
+            if (tournament.positionsFile == NULL)
+            {
+                printf("Failed to open %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-nnue") == 0 && !loadNetwork(argv[i + 1]))
+        {
+            printf("Failed to load network %s, using the classical evaluation\n", argv[i + 1]);
+        }
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        tournament.engines[i].table = newTranspositionTable();
+        if (tournament.engines[i].table == NULL)
+        {
+            puts("Failed to allocate a transposition table");
+            return 1;
+        }
+    }
+    if (concurrency < 1)
+    {
+        concurrency = 1;
+    }
+    if (concurrency > MAX_WORKERS)
+    {
+        concurrency = MAX_WORKERS;
+    }
+    pthread_mutex_init(&tournament.mutex, NULL);
+    pthread_t workers[MAX_WORKERS];
+    RngState workerRngs[MAX_WORKERS];
+    int numWorkers = 0;
+    for (int i = 0; i < concurrency; i++)
+    {
+        workerRngs[i].state = pcgGetRandom64(&rng);
+        workerRngs[i].inc = pcgGetRandom64(&rng) | 1;
+        if (pthread_create(&workers[numWorkers], NULL, workerThread, &workerRngs[i]) != 0)
+        {
+            puts("Failed to create worker thread");
+            break;
+        }
+        numWorkers++;
+    }
+    for (int i = 0; i < numWorkers; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    if (tournament.positionsFile != NULL)
+    {
+        fclose(tournament.positionsFile);
+    }
+    if (tournament.wins + tournament.losses + tournament.draws == 0)
+    {
+        puts("No games played");
+        return 1;
+    }
+    return 0;
+}
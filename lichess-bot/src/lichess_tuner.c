@@ -0,0 +1,377 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lichess_game.h"
+
+/* Texel tuning of the classical evaluation.  Positions labelled with the result of the game they came from
+   (as written by the tournament runner's -positions option) are evaluated with the current weights,
+   and each weight is nudged up or down while that lowers the mean squared error between the game results
+   and the evaluations mapped to an expected score.  The tuned weights are written as a header the engines compile in. */
+
+#define MAX_WORKERS 64
+#define MAX_PARAMETERS 1024
+#define MAX_OUTPUTS 8
+
+// Defined writable by lichess_game.c when built with TUNING
+extern int middlegameValues[7];
+extern int endgameValues[7];
+extern int middlegameTables[7][64];
+extern int endgameTables[7][64];
+extern int passedPawnMiddlegame[8];
+extern int passedPawnEndgame[8];
+extern int doubledPawn[2];
+extern int isolatedPawn[2];
+extern int backwardPawn[2];
+extern int mobilityMiddlegame[7];
+extern int mobilityEndgame[7];
+extern int kingAttackWeights[7];
+
+typedef struct Position
+{
+    uint8_t board[64];
+    uint8_t result; // Half points for white
+} Position;
+
+typedef struct Worker
+{
+    int first;
+    int last;
+    double scalingConstant;
+    double error;
+} Worker;
+
+static Position *positions;
+static int numPositions;
+static int numWorkers = 1;
+static int *parameters[MAX_PARAMETERS];
+static int numParameters;
+
+// Reads positions in the form "FEN [1.0]", or EPD with a "1-0", "0-1" or "1/2-1/2" result.
+static bool loadPositions(const char *fileName)
+{
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL)
+    {
+        printf("Failed to open %s\n", fileName);
+        return false;
+    }
+    static int capacity = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        int result;
+        if (strstr(line, "[1.0]") != NULL || strstr(line, "1-0") != NULL)
+        {
+            result = 2;
+        }
+        else if (strstr(line, "[0.0]") != NULL || strstr(line, "0-1") != NULL)
+        {
+            result = 0;
+        }
+        else if (strstr(line, "[0.5]") != NULL || strstr(line, "1/2-1/2") != NULL)
+        {
+            result = 1;
+        }
+        else
+        {
+            continue;
+        }
+        // Only the board, side to move, castling and en passant fields are kept.  Move counters don't affect the evaluation.
+        char fen[128];
+        int length = 0;
+        int fields = 0;
+        for (char *c = line; *c != 0 && *c != '\n' && length < 100; c++)
+        {
+            if (*c == ' ' && ++fields == 4)
+            {
+                break;
+            }
+            fen[length++] = *c;
+        }
+        if (fields < 4)
+        {
+            continue;
+        }
+        snprintf(fen + length, sizeof(fen) - length, " 0 1");
+        if (numPositions == capacity)
+        {
+            capacity = capacity > 0 ? capacity * 2 : 1 << 16;
+            Position *newPositions = realloc(positions, capacity * sizeof(Position));
+            if (newPositions == NULL)
+            {
+                puts("loadPositions: realloc failed");
+                fclose(file);
+                return false;
+            }
+            positions = newPositions;
+        }
+        GameState state;
+        loadFenString(fen, &state);
+        memcpy(positions[numPositions].board, state.board, 64);
+        positions[numPositions].result = result;
+        numPositions++;
+    }
+    fclose(file);
+    return true;
+}
+
+static void *errorThread(void *arg)
+{
+    Worker *worker = arg;
+    GameState state;
+    memset(&state, 0, sizeof(state));
+    state.playerToMove = WHITE;
+    double error = 0.0;
+    for (int i = worker->first; i < worker->last; i++)
+    {
+        memcpy(state.board, positions[i].board, 64);
+        int evaluation = tuningEvaluation(&state);
+        double expected = 1.0 / (1.0 + pow(10.0, -worker->scalingConstant * evaluation / 400.0));
+        double difference = positions[i].result / 2.0 - expected;
+        error += difference * difference;
+    }
+    worker->error = error;
+    return NULL;
+}
+
+// Mean squared error over all positions, split between worker threads.
+static double computeError(double scalingConstant)
+{
+    Worker workers[MAX_WORKERS];
+    pthread_t threads[MAX_WORKERS];
+    bool started[MAX_WORKERS];
+    for (int i = 0; i < numWorkers; i++)
+    {
+        workers[i].first = (int)((int64_t)numPositions * i / numWorkers);
+        workers[i].last = (int)((int64_t)numPositions * (i + 1) / numWorkers);
+        workers[i].scalingConstant = scalingConstant;
+        started[i] = i > 0 && pthread_create(&threads[i], NULL, errorThread, &workers[i]) == 0;
+    }
+    errorThread(&workers[0]);
+    double error = 0.0;
+    for (int i = 0; i < numWorkers; i++)
+    {
+        if (i > 0 && started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+        else if (i > 0)
+        {
+            errorThread(&workers[i]);
+        }
+        error += workers[i].error;
+    }
+    return error / numPositions;
+}
+
+// The constant mapping evaluations to expected scores that best fits the untuned weights.
+static double findScalingConstant(void)
+{
+    double best = 1.0;
+    double bestError = computeError(best);
+    for (double step = 0.1; step > 0.0005; step /= 10.0)
+    {
+        for (int direction = -1; direction <= 1; direction += 2)
+        {
+            double error;
+            while (best + direction * step > 0.0 && (error = computeError(best + direction * step)) < bestError)
+            {
+                best += direction * step;
+                bestError = error;
+            }
+        }
+    }
+    return best;
+}
+
+static void addParameters(int *values, int first, int last)
+{
+    for (int i = first; i < last; i++)
+    {
+        parameters[numParameters++] = &values[i];
+    }
+}
+
+// Piece type 0, the king's material value and the back ranks of the pawn tables are never used.
+static void initParameters(void)
+{
+    addParameters(middlegameValues, PAWN, KING);
+    addParameters(endgameValues, PAWN, KING);
+    for (int pieceType = PAWN; pieceType <= KING; pieceType++)
+    {
+        int first = pieceType == PAWN ? 8 : 0;
+        int last = pieceType == PAWN ? 56 : 64;
+        addParameters(middlegameTables[pieceType], first, last);
+        addParameters(endgameTables[pieceType], first, last);
+    }
+    addParameters(passedPawnMiddlegame, 1, 7);
+    addParameters(passedPawnEndgame, 1, 7);
+    addParameters(doubledPawn, 0, 2);
+    addParameters(isolatedPawn, 0, 2);
+    addParameters(backwardPawn, 0, 2);
+    addParameters(mobilityMiddlegame, BISHOP, KING);
+    addParameters(mobilityEndgame, BISHOP, KING);
+    addParameters(kingAttackWeights, BISHOP, KING);
+}
+
+static void writeArray(FILE *file, const char *name, const int *values, int count)
+{
+    fprintf(file, "WEIGHT int %s[%d] = {", name, count);
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(file, i > 0 ? ", %d" : "%d", values[i]);
+    }
+    fputs("};\n", file);
+}
+
+static void writeTables(FILE *file, const char *name, int tables[7][64])
+{
+    static const char *pieceNames[7] = {NULL, "Pawn", "Bishop", "Knight", "Rook", "Queen", "King"};
+    fprintf(file, "WEIGHT int %s[7][64] =\n{\n    {0},\n", name);
+    for (int pieceType = PAWN; pieceType <= KING; pieceType++)
+    {
+        fprintf(file, "    // %s\n    {\n", pieceNames[pieceType]);
+        for (int row = 0; row < 8; row++)
+        {
+            fputs("        ", file);
+            for (int col = 0; col < 8; col++)
+            {
+                fprintf(file, col < 7 ? "%4d, " : "%4d", tables[pieceType][row * 8 + col]);
+            }
+            fputs(row < 7 ? ",\n" : "\n", file);
+        }
+        fputs(pieceType < KING ? "    },\n" : "    }\n", file);
+    }
+    fputs("};\n", file);
+}
+
+static bool writeWeights(const char *fileName)
+{
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL)
+    {
+        printf("Failed to open %s\n", fileName);
+        return false;
+    }
+    fputs("// Evaluation weights in centipawns.  Set by hand to start with.  The tuner (see tuner-build.sh) rewrites this file.\n"
+        "#ifndef WEIGHTS_H\n"
+        "#define WEIGHTS_H\n"
+        "\n"
+        "// The tuner build defines WEIGHT so the weights can be changed at run time\n"
+        "#ifndef WEIGHT\n"
+        "#define WEIGHT static const\n"
+        "#endif\n"
+        "\n"
+        "// Material and piece-square values for the middlegame and endgame, indexed by piece type.\n"
+        "// Tables are from white's side with a8 first.  Black pieces look up the square mirrored vertically.\n", file);
+    writeArray(file, "middlegameValues", middlegameValues, 7);
+    writeArray(file, "endgameValues", endgameValues, 7);
+    writeTables(file, "middlegameTables", middlegameTables);
+    fputs("\n", file);
+    writeTables(file, "endgameTables", endgameTables);
+    fputs("\n// Pawn structure.  Passed pawn bonuses are indexed by how far the pawn has advanced, the rest are middlegame then endgame.\n", file);
+    writeArray(file, "passedPawnMiddlegame", passedPawnMiddlegame, 8);
+    writeArray(file, "passedPawnEndgame", passedPawnEndgame, 8);
+    writeArray(file, "doubledPawn", doubledPawn, 2);
+    writeArray(file, "isolatedPawn", isolatedPawn, 2);
+    writeArray(file, "backwardPawn", backwardPawn, 2);
+    fputs("\n// Mobility per square beyond the typical count and king attack units per square of the king zone, indexed by piece type.\n", file);
+    writeArray(file, "mobilityMiddlegame", mobilityMiddlegame, 7);
+    writeArray(file, "mobilityEndgame", mobilityEndgame, 7);
+    writeArray(file, "kingAttackWeights", kingAttackWeights, 7);
+    fputs("\n#endif\n", file);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *outputs[MAX_OUTPUTS];
+    int numOutputs = 0;
+    int maxPasses = 100;
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-positions") == 0)
+        {
+            if (!loadPositions(argv[i + 1]))
+            {
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-threads") == 0)
+        {
+            numWorkers = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-passes") == 0)
+        {
+            maxPasses = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-output") == 0 && numOutputs < MAX_OUTPUTS)
+        {
+            outputs[numOutputs++] = argv[i + 1];
+        }
+    }
+    if (numOutputs == 0)
+    {
+        outputs[numOutputs++] = "include/weights.h";
+    }
+    if (numWorkers < 1)
+    {
+        numWorkers = 1;
+    }
+    if (numWorkers > MAX_WORKERS)
+    {
+        numWorkers = MAX_WORKERS;
+    }
+    if (numPositions == 0)
+    {
+        puts("No positions loaded");
+        return 1;
+    }
+    initSearch();
+    initParameters();
+    printf("Loaded %d positions, tuning %d weights\n", numPositions, numParameters);
+    double scalingConstant = findScalingConstant();
+    double bestError = computeError(scalingConstant);
+    printf("Scaling constant %.3f, error %.8f\n", scalingConstant, bestError);
+    for (int pass = 0; pass < maxPasses; pass++)
+    {
+        int changed = 0;
+        for (int i = 0; i < numParameters; i++)
+        {
+            *parameters[i] += 1;
+            double error = computeError(scalingConstant);
+            if (error < bestError)
+            {
+                bestError = error;
+                changed++;
+                continue;
+            }
+            *parameters[i] -= 2;
+            error = computeError(scalingConstant);
+            if (error < bestError)
+            {
+                bestError = error;
+                changed++;
+                continue;
+            }
+            *parameters[i] += 1;
+        }
+        printf("Pass %d: error %.8f, %d weights changed\n", pass + 1, bestError, changed);
+        // Saved after every pass so a long run can be stopped early
+        for (int i = 0; i < numOutputs; i++)
+        {
+            writeWeights(outputs[i]);
+        }
+        if (changed == 0)
+        {
+            break;
+        }
+    }
+    return 0;
+}
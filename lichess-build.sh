@@ -1 +1 @@
-gcc lichess-bot/src/lichess_main.c lichess-bot/src/lichess_random.c lichess-bot/src/lichess_game.c -I lichess-bot/include -o lichess -std=c99 -Wall -O3 -pthread -lpthread -lcurl
+gcc lichess-bot/src/lichess_main.c lichess-bot/src/lichess_random.c lichess-bot/src/lichess_book.c lichess-bot/src/lichess_game.c lichess-bot/src/lichess_nnue.c -I lichess-bot/include -I include -o lichess -std=c99 -Wall -O3 -pthread -lpthread -lcurl -lm
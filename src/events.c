@@ -19,6 +19,7 @@ void leftClickEvent(int x, int y, bool playerGame)
     if (gameOverString != NULL)
     {
         gameOverString = NULL;
+        stopPondering();
         initGameState();
         numHightlighted = 0;
         if (!playerGame)
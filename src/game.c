@@ -1,4 +1,6 @@
 #include <inttypes.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,13 +8,129 @@
 #include "game.h"
 #include "pcgrandom.h"
 #include "platform.h"
+#include "weights.h"
 
-#define CHECKMATE_EVALUATION -9001
+#define CHECKMATE_EVALUATION -30000
 #define STALEMATE_EVALUATION 0
 
+#define SEARCH_DEPTH 4
+#define ASPIRATION_WINDOW 50
+#define NULL_MOVE_REDUCTION 2
+#define NULL_MOVE_MIN_DEPTH 3
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES 3
+// Extensions are counted in fractions of a ply
+#define ONE_PLY 4
+#define CHECK_EXTENSION 3
+#define SINGLE_REPLY_EXTENSION 2
+#define MAX_EXTENSION (4 * ONE_PLY) // Per path from the root
+// Pruning margins near the leaves, in evaluation units
+#define FUTILITY_MARGIN 200
+#define EXTENDED_FUTILITY_MARGIN 500
+#define RAZOR_MARGIN 300
+#define RAZOR_DEPTH 2
+#define MAX_SEARCH_DEPTH 64
+#define MAX_PHASE 24
+// Scores past this are mates.  Checkmate scores are adjusted by ply so shorter mates score higher.
+#define MATE_THRESHOLD (-CHECKMATE_EVALUATION - MAX_SEARCH_DEPTH)
+#define HISTORY_MAX 16384
+#define MAX_SEARCH_THREADS 64
+#define STOP_CHECK_NODES 1024 // How often search limits are checked.  Must be a power of 2.
+#define MAX_GAME_HASHES 256
+#define DEFAULT_HASH_SIZE 16 // Transposition table megabytes
+#define PAWN_TABLE_SIZE (1 << 14)
+#define EVAL_CACHE_SIZE (1 << 14)
+
+// Transposition table bound types
+#define TT_EXACT 0
+#define TT_LOWER 1
+#define TT_UPPER 2
+
+// Move ordering statistics, repetition history and search limits for one search thread.
+typedef struct SearchData
+{
+    uint16_t killerMoves[MAX_SEARCH_DEPTH][2];
+    uint16_t counterMoves[64][64];
+    int history[2][64][64];
+    uint64_t hashStack[MAX_SEARCH_DEPTH];
+    int extensions[MAX_SEARCH_DEPTH];
+    uint64_t gameHashes[MAX_GAME_HASHES];
+    int numGameHashes;
+    const SearchLimits *limits;
+    uint64_t startTime;
+    uint64_t nodes;
+    bool stopped;
+} SearchData;
+
+typedef struct SearchThread
+{
+    GameState state;
+    SearchData data;
+    int id;
+    int maxDepth;
+    int numMoves;
+    int completedDepth;
+    int bestScore;
+    uint16_t bestMove;
+    uint16_t moves[1024];
+    int numThreads; // Set on the main thread, which comes first in the array of all the search's threads
+} SearchThread;
+
+typedef struct TTEntry
+{
+    uint64_t key;
+    uint64_t data;
+} TTEntry;
+
+// A search running in the background on the position after the opponent's expected reply.
+typedef struct PonderSearch
+{
+    GameState state;
+    uint64_t history[MAX_GAME_HASHES];
+    int historyLength;
+    SearchLimits limits;
+    RngState rng; // Its own, since the search runs alongside the main thread
+    void *thread;
+    volatile bool stop;
+    uint16_t move;
+} PonderSearch;
+
 GameState gameState;
 static Zobrist zobrist;
-static Position positionTable[1024];
+// Hashes of the positions since the last capture or pawn move, oldest first.
+static uint64_t *positionHistory;
+static int positionHistoryLength;
+static int positionHistoryCapacity;
+static int lateMoveReductions[MAX_SEARCH_DEPTH][64];
+static TTEntry *transpositionTable;
+static uint64_t transpositionTableMask;
+static TTEntry pawnTable[PAWN_TABLE_SIZE];
+static TTEntry evaluationCache[EVAL_CACHE_SIZE];
+static int numSearchThreads = 1;
+static PonderSearch ponderSearch;
+static SearchLimits searchLimits = {SEARCH_DEPTH, 0, 0, NULL, 0, NULL};
+static volatile bool searchAborted;
+static uint8_t knightTargets[64][8];
+static int numKnightTargets[64];
+static uint8_t kingTargets[64][8];
+static int numKingTargets[64];
+// Squares along each direction from a square, nearest first.  Diagonals are directions 0-3 and straight lines 4-7.
+static uint8_t rays[64][8][7];
+static int rayLengths[64][8];
+
+// Piece values used by static exchange evaluation, indexed by piece type.
+static const int seeValues[7] = {0, 100, 300, 300, 500, 900, 20000};
+
+// Each side's non-pawn material counts towards the game phase.  Evaluation blends
+// from the middlegame score at MAX_PHASE to the endgame score at 0.
+static const int phaseValues[7] = {0, 0, 1, 1, 2, 4, 0};
+
+/* Mobility is scored per square attacked beyond a typical count, leaving out squares held by friendly pieces
+   or covered by enemy pawns.  Pieces hitting squares around the enemy king add attack units, weighted by piece type,
+   and only count when at least two pieces join the attack. */
+static const int mobilityBaseline[7] = {0, 0, 6, 4, 7, 13, 0};
+#define KING_ATTACK_SCALE 4 // Middlegame penalty is units squared over this
+#define MAX_KING_ATTACK_PENALTY 500
 
 static int zobristPieceLookup(int cell, uint8_t piece)
 {
@@ -29,95 +147,106 @@ static int zobristPieceLookup(int cell, uint8_t piece)
     return (cell * 12) + pieceOffset;
 }
 
-static bool comparePosition(GameState *state, Position *position)
+static int getPositionOccurences(GameState *state)
 {
-    if (state->playerToMove != position->playerToMove)
-    {
-        return false;
-    }
-    if (state->enPassantSquare != position->enPassantSquare)
+    // Only positions with the same player to move can match, so step back two at a time from the current one.
+    int occurences = 0;
+    for (int i = positionHistoryLength - 1; i >= 0; i -= 2)
     {
-        return false;
+        if (positionHistory[i] == state->hash)
+        {
+            occurences++;
+        }
     }
-    if (state->castlingAvailablity != position->castlingAvailability)
+    return occurences;
+}
+
+// Copies the end of the position history, the positions that could repeat in a search from this one.
+static int collectGameHistory(uint64_t *hashes)
+{
+    int length = positionHistoryLength < MAX_GAME_HASHES ? positionHistoryLength : MAX_GAME_HASHES;
+    memcpy(hashes, positionHistory + positionHistoryLength - length, length * sizeof(uint64_t));
+    return length;
+}
+
+static void addPosition(GameState *state)
+{
+    // Nothing before a capture or pawn move can repeat.
+    if (state->halfMoves == 0)
     {
-        return false;
+        positionHistoryLength = 0;
     }
-    for (int i = 0; i < 64; i++)
+    if (positionHistoryLength == positionHistoryCapacity)
     {
-        if (state->board[i] != position->board[i])
+        int newCapacity = positionHistoryCapacity > 0 ? positionHistoryCapacity * 2 : 128;
+        uint64_t *newHistory = realloc(positionHistory, newCapacity * sizeof(uint64_t));
+        if (newHistory == NULL)
         {
-            return false;
+            debugLog("addPosition: realloc failed");
+            return;
         }
+        positionHistory = newHistory;
+        positionHistoryCapacity = newCapacity;
     }
-    return true;
+    positionHistory[positionHistoryLength++] = state->hash;
 }
 
-static int getPositionOccurences(GameState *state)
+// Adds (sign 1) or removes (sign -1) a piece's contribution to the running evaluation and network accumulator.
+static void updatePieceScore(int cell, uint8_t piece, int sign, GameState *state)
 {
-    uint64_t startingLookup = state->hash & 1023;
-    uint64_t lookup = startingLookup;
-    while (positionTable[lookup].occurences > 0)
+    if (networkLoaded())
     {
-        if (positionTable[lookup].hash == state->hash)
+        if (sign > 0)
         {
-            if (comparePosition(state, &positionTable[lookup]))
-            {
-                return positionTable[lookup].occurences;
-            }
-            debugLog("Zobrist hash collision (should be very rare)");
+            addFeature(cell, piece, &state->accumulator);
         }
-        lookup = (lookup + 1) & 1023;
-        if (lookup == startingLookup)
+        else
         {
-            debugLog("Position table is full");
-            return 0;
+            removeFeature(cell, piece, &state->accumulator);
         }
     }
-    return 0;
+    uint8_t pieceType = piece & PIECE_TYPE_MASK;
+    state->phase += sign * phaseValues[pieceType];
+    if ((piece & PIECE_OWNER_MASK) == BLACK)
+    {
+        cell ^= 56;
+        sign = -sign;
+    }
+    state->middlegameScore += sign * (middlegameValues[pieceType] + middlegameTables[pieceType][cell]);
+    state->endgameScore += sign * (endgameValues[pieceType] + endgameTables[pieceType][cell]);
 }
 
-static void addPosition(GameState *state)
+static void scorePosition(GameState *state)
 {
-    uint64_t startingLookup = state->hash & 1023;
-    uint64_t lookup = startingLookup;
-    while (positionTable[lookup].occurences > 0)
+    state->middlegameScore = 0;
+    state->endgameScore = 0;
+    state->phase = 0;
+    if (networkLoaded())
     {
-        if (positionTable[lookup].hash == state->hash)
-        {
-            if (comparePosition(state, &positionTable[lookup]))
-            {
-                positionTable[lookup].occurences++;
-                return;
-            }
-            debugLog("Zobrist hash collision (should be very rare)");
-        }
-        lookup = (lookup + 1) & 1023;
-        if (lookup == startingLookup)
-        {
-            debugLog("Position table is full");
-            return;
-        }
+        resetAccumulator(&state->accumulator);
     }
-    positionTable[lookup].hash = state->hash;
-    positionTable[lookup].occurences = 1;
-    positionTable[lookup].playerToMove = state->playerToMove;
-    positionTable[lookup].enPassantSquare = state->enPassantSquare;
-    positionTable[lookup].castlingAvailability = state->castlingAvailablity;
     for (int i = 0; i < 64; i++)
     {
-        positionTable[lookup].board[i] = state->board[i];
+        if (state->board[i] != 0)
+        {
+            updatePieceScore(i, state->board[i], 1, state);
+        }
     }
 }
 
 static void hashStartingPosition(void)
 {
     gameState.hash = 0;
+    gameState.pawnHash = 0;
     for (int i = 0; i < 64; i++)
     {
         if (gameState.board[i] != 0)
         {
             gameState.hash ^= zobrist.pieces[zobristPieceLookup(i, gameState.board[i])];
+            if ((gameState.board[i] & PIECE_TYPE_MASK) == PAWN)
+            {
+                gameState.pawnHash ^= zobrist.pieces[zobristPieceLookup(i, gameState.board[i])];
+            }
         }
     }
     if (gameState.castlingAvailablity & CASTLE_BLACK_QUEEN)
@@ -140,10 +269,20 @@ static void hashStartingPosition(void)
     {
         gameState.hash ^= zobrist.enPassantFile[gameState.enPassantSquare % 8];
     }
-    memset(positionTable, 0, 1024 * sizeof(Position));
+    if (gameState.playerToMove == BLACK)
+    {
+        gameState.hash ^= zobrist.playerToMove;
+    }
+    positionHistoryLength = 0;
     addPosition(&gameState);
 }
 
+// Copy for copy-make.  The network accumulator is large, so it's only copied while a network is loaded.
+static void copyGameState(GameState *copy, const GameState *state)
+{
+    memcpy(copy, state, networkLoaded() ? sizeof(GameState) : offsetof(GameState, accumulator));
+}
+
 void movePiece(uint16_t move, GameState *state)
 {
     uint8_t moveTo = move & MOVE_TO_MASK;
@@ -154,9 +293,19 @@ void movePiece(uint16_t move, GameState *state)
     uint8_t capturedPiece = state->board[moveTo];
     uint8_t prevCastling = state->castlingAvailablity;
     state->hash ^= zobrist.pieces[zobristPieceLookup(moveFrom, piece)];
+    updatePieceScore(moveFrom, piece, -1, state);
+    if (pieceType == PAWN)
+    {
+        state->pawnHash ^= zobrist.pieces[zobristPieceLookup(moveFrom, piece)];
+    }
     if (capturedPiece != 0)
     {
         state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo, capturedPiece)];
+        updatePieceScore(moveTo, capturedPiece, -1, state);
+        if ((capturedPiece & PIECE_TYPE_MASK) == PAWN)
+        {
+            state->pawnHash ^= zobrist.pieces[zobristPieceLookup(moveTo, capturedPiece)];
+        }
     }
     if (capturedPiece != 0 || pieceType == PAWN)
     {
@@ -182,6 +331,8 @@ void movePiece(uint16_t move, GameState *state)
             else if (move & CASTLE_ENPASSANT_FLAG)
             {
                 state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo - 8, state->board[moveTo - 8])];
+                state->pawnHash ^= zobrist.pieces[zobristPieceLookup(moveTo - 8, state->board[moveTo - 8])];
+                updatePieceScore(moveTo - 8, state->board[moveTo - 8], -1, state);
                 state->board[moveTo - 8] = 0;
             }
         }
@@ -194,6 +345,8 @@ void movePiece(uint16_t move, GameState *state)
             else if (move & CASTLE_ENPASSANT_FLAG)
             {
                 state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo + 8, state->board[moveTo + 8])];
+                state->pawnHash ^= zobrist.pieces[zobristPieceLookup(moveTo + 8, state->board[moveTo + 8])];
+                updatePieceScore(moveTo + 8, state->board[moveTo + 8], -1, state);
                 state->board[moveTo + 8] = 0;
             }
         }
@@ -219,6 +372,8 @@ void movePiece(uint16_t move, GameState *state)
             {
                 state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo + 1, state->board[moveTo + 1])];
                 state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo - 1, state->board[moveTo + 1])];
+                updatePieceScore(moveTo + 1, state->board[moveTo + 1], -1, state);
+                updatePieceScore(moveTo - 1, state->board[moveTo + 1], 1, state);
                 state->board[moveTo - 1] = state->board[moveTo + 1];
                 state->board[moveTo + 1] = 0;
             }
@@ -226,6 +381,8 @@ void movePiece(uint16_t move, GameState *state)
             {
                 state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo - 2, state->board[moveTo - 2])];
                 state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo + 1, state->board[moveTo - 2])];
+                updatePieceScore(moveTo - 2, state->board[moveTo - 2], -1, state);
+                updatePieceScore(moveTo + 1, state->board[moveTo - 2], 1, state);
                 state->board[moveTo + 1] = state->board[moveTo - 2];
                 state->board[moveTo - 2] = 0;
             }
@@ -283,12 +440,38 @@ void movePiece(uint16_t move, GameState *state)
     }
     state->hash ^= zobrist.playerToMove;
     state->hash ^= zobrist.pieces[zobristPieceLookup(moveTo, piece)];
+    updatePieceScore(moveTo, piece, 1, state);
+    if ((piece & PIECE_TYPE_MASK) == PAWN)
+    {
+        state->pawnHash ^= zobrist.pieces[zobristPieceLookup(moveTo, piece)];
+    }
     if (state == &gameState)
     {
         addPosition(state);
     }
 }
 
+// Passes the turn to the opponent.  Only used by the AI search.
+static void makeNullMove(GameState *state)
+{
+    if (state->enPassantSquare != 255)
+    {
+        state->hash ^= zobrist.enPassantFile[state->enPassantSquare % 8];
+        state->enPassantSquare = 255;
+    }
+    if (state->playerToMove == WHITE)
+    {
+        state->playerToMove = BLACK;
+    }
+    else
+    {
+        state->playerToMove = WHITE;
+    }
+    state->hash ^= zobrist.playerToMove;
+    // A repetition across a null move isn't a real one.
+    state->halfMoves = 0;
+}
+
 static uint8_t getKingLocation(uint8_t owner, GameState *state)
 {
     uint8_t king = owner | KING;
@@ -854,7 +1037,8 @@ int pieceLegalMoves(uint8_t cell, uint16_t *moves, GameState *state)
         }
         else
         {
-            GameState copyState = *state;
+            GameState copyState;
+            copyGameState(&copyState, state);
             movePiece(possibleMoves[i], &copyState);
             uint8_t king = getKingLocation(owner, &copyState);
             for (int j = 0; j < 64; j++)
@@ -886,26 +1070,7 @@ int pieceLegalMoves(uint8_t cell, uint16_t *moves, GameState *state)
     return numLegalMoves;
 }
 
-static void orderMoves(uint16_t *moves, int numMoves, GameState *state)
-{
-    int goodMoves = 0;
-    for (int i = 0; i < numMoves; i++)
-    {
-        uint16_t moveTo = moves[i] & MOVE_TO_MASK;
-        uint16_t moveFrom = (moves[i] & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
-        uint8_t capturedPieceType = state->board[moveTo] & PIECE_TYPE_MASK;
-        uint8_t capturingPieceType = state->board[moveFrom] & PIECE_TYPE_MASK;
-        if (capturingPieceType < capturedPieceType)
-        {
-            uint16_t temp = moves[goodMoves];
-            moves[goodMoves] = moves[i];
-            moves[i] = temp;
-            goodMoves++;
-        }
-    }
-}
-
-static int getAllLegalMoves(uint16_t *moves, GameState *state)
+int getAllLegalMoves(uint16_t *moves, GameState *state)
 {
     uint8_t player = state->playerToMove;
     int totalMoves = 0;
@@ -917,10 +1082,6 @@ static int getAllLegalMoves(uint16_t *moves, GameState *state)
             totalMoves += numMoves;
         }
     }
-    /* Order moves putting possible best moves first.
-       This improves AI search performance with alpha-beta pruning.
-       Doesn't actually change results.  It's just a guess. */
-    orderMoves(moves, totalMoves, state);
     return totalMoves;
 }
 
@@ -966,7 +1127,8 @@ static uint64_t calculatePositionsEx(int depth, int startingDepth, GameState *st
     int numMoves = getAllLegalMoves(moves, state);
     for (int i = 0; i < numMoves; i++)
     {
-        GameState copyState = *state;
+        GameState copyState;
+        copyGameState(&copyState, state);
         movePiece(moves[i], &copyState);
         uint64_t positions = calculatePositionsEx(depth - 1, startingDepth, &copyState);
         totalPositions += positions;
@@ -1019,170 +1181,1418 @@ enum GameEnd checkGameEnd(GameState *state)
     return STALEMATE;
 }
 
-static int AIEvaluate(GameState *state)
+/* Middlegame and endgame pawn structure scores from white's side: passed, doubled, isolated and backward pawns.
+   Rows count from the 8th rank, so white pawns advance towards row 0 and black pawns towards row 7. */
+static void evaluatePawnStructure(GameState *state, int *middlegame, int *endgame)
 {
-    enum GameEnd end = checkGameEnd(state);
-    if (end == CHECKMATE)
+    int numPawns[2][8] = {{0}};
+    int minRow[2][8];
+    int maxRow[2][8];
+    for (int i = 0; i < 8; i++)
     {
-        return CHECKMATE_EVALUATION;
+        minRow[0][i] = minRow[1][i] = 8;
+        maxRow[0][i] = maxRow[1][i] = -1;
     }
-    if (end == STALEMATE)
+    for (int i = 0; i < 64; i++)
     {
-        return STALEMATE_EVALUATION;
+        if ((state->board[i] & PIECE_TYPE_MASK) == PAWN)
+        {
+            int side = (state->board[i] & PIECE_OWNER_MASK) == WHITE ? 0 : 1;
+            int row = i / 8;
+            int col = i % 8;
+            numPawns[side][col]++;
+            if (row < minRow[side][col])
+            {
+                minRow[side][col] = row;
+            }
+            if (row > maxRow[side][col])
+            {
+                maxRow[side][col] = row;
+            }
+        }
     }
-    uint8_t player = state->playerToMove;
-    int evaluation = 0;
+    *middlegame = 0;
+    *endgame = 0;
     for (int i = 0; i < 64; i++)
     {
-        uint8_t pieceType = state->board[i] & PIECE_TYPE_MASK;
-        uint8_t pieceOwner = state->board[i] & PIECE_OWNER_MASK;
-        switch (pieceType)
+        if ((state->board[i] & PIECE_TYPE_MASK) != PAWN)
         {
-            case PAWN:
+            continue;
+        }
+        bool white = (state->board[i] & PIECE_OWNER_MASK) == WHITE;
+        int side = white ? 0 : 1;
+        int sign = white ? 1 : -1;
+        int row = i / 8;
+        int col = i % 8;
+        int advanced = white ? 7 - row : row;
+        bool passed = true;
+        bool isolated = true;
+        bool supported = false;
+        for (int file = col - 1; file <= col + 1; file++)
+        {
+            if (file < 0 || file > 7)
             {
-                if (pieceOwner == player)
-                {
-                    evaluation++;
-                }
-                else
+                continue;
+            }
+            // Enemy pawns ahead on this or an adjacent file stop a pawn from being passed.
+            if (white ? minRow[1][file] < row : maxRow[0][file] > row)
+            {
+                passed = false;
+            }
+            if (file != col && numPawns[side][file] > 0)
+            {
+                isolated = false;
+                // A friendly pawn level with or behind this one can still advance to defend it.
+                if (white ? maxRow[0][file] >= row : minRow[1][file] <= row)
                 {
-                    evaluation--;
+                    supported = true;
                 }
-                break;
             }
-            case BISHOP:
-            case KNIGHT:
+        }
+        if (passed)
+        {
+            *middlegame += sign * passedPawnMiddlegame[advanced];
+            *endgame += sign * passedPawnEndgame[advanced];
+        }
+        if (isolated)
+        {
+            *middlegame += sign * isolatedPawn[0];
+            *endgame += sign * isolatedPawn[1];
+        }
+        else if (!supported)
+        {
+            // Backward.  Nothing can defend it and an enemy pawn guards the square in front.
+            int attackerRow = white ? row - 2 : row + 2;
+            uint8_t enemyPawn = white ? (BLACK | PAWN) : (WHITE | PAWN);
+            if (attackerRow >= 0 && attackerRow <= 7
+                && ((col > 0 && state->board[attackerRow * 8 + col - 1] == enemyPawn)
+                || (col < 7 && state->board[attackerRow * 8 + col + 1] == enemyPawn)))
+            {
+                *middlegame += sign * backwardPawn[0];
+                *endgame += sign * backwardPawn[1];
+            }
+        }
+    }
+    for (int col = 0; col < 8; col++)
+    {
+        if (numPawns[0][col] > 1)
+        {
+            *middlegame += (numPawns[0][col] - 1) * doubledPawn[0];
+            *endgame += (numPawns[0][col] - 1) * doubledPawn[1];
+        }
+        if (numPawns[1][col] > 1)
+        {
+            *middlegame -= (numPawns[1][col] - 1) * doubledPawn[0];
+            *endgame -= (numPawns[1][col] - 1) * doubledPawn[1];
+        }
+    }
+}
+
+// Middlegame and endgame mobility and king attack scores from white's side.
+static void evaluatePieceActivity(GameState *state, int *middlegame, int *endgame)
+{
+    uint64_t pawnAttacks[2] = {0, 0};
+    uint64_t kingZones[2] = {0, 0};
+    for (int i = 0; i < 64; i++)
+    {
+        uint8_t pieceType = state->board[i] & PIECE_TYPE_MASK;
+        int side = (state->board[i] & PIECE_OWNER_MASK) == WHITE ? 0 : 1;
+        if (pieceType == PAWN)
+        {
+            int row = side == 0 ? i / 8 - 1 : i / 8 + 1;
+            int col = i % 8;
+            if (row >= 0 && row < 8)
             {
-                if (pieceOwner == player)
+                if (col > 0)
                 {
-                    evaluation += 3;
+                    pawnAttacks[side] |= 1ULL << (row * 8 + col - 1);
                 }
-                else
+                if (col < 7)
                 {
-                    evaluation -= 3;
+                    pawnAttacks[side] |= 1ULL << (row * 8 + col + 1);
                 }
-                break;
             }
-            case ROOK:
+        }
+        else if (pieceType == KING)
+        {
+            kingZones[side] |= 1ULL << i;
+            for (int j = 0; j < numKingTargets[i]; j++)
+            {
+                kingZones[side] |= 1ULL << kingTargets[i][j];
+            }
+        }
+    }
+    int kingAttackers[2] = {0, 0};
+    int kingAttackUnits[2] = {0, 0};
+    *middlegame = 0;
+    *endgame = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        uint8_t pieceType = state->board[i] & PIECE_TYPE_MASK;
+        if (pieceType == 0 || pieceType == PAWN || pieceType == KING)
+        {
+            continue;
+        }
+        uint8_t owner = state->board[i] & PIECE_OWNER_MASK;
+        int side = owner == WHITE ? 0 : 1;
+        int sign = owner == WHITE ? 1 : -1;
+        int mobility = 0;
+        int zoneAttacks = 0;
+        if (pieceType == KNIGHT)
+        {
+            for (int j = 0; j < numKnightTargets[i]; j++)
             {
-                if (pieceOwner == player)
+                uint8_t cell = knightTargets[i][j];
+                if ((state->board[cell] & PIECE_OWNER_MASK) != owner && !(pawnAttacks[1 - side] & (1ULL << cell)))
                 {
-                    evaluation += 5;
+                    mobility++;
                 }
-                else
+                if (kingZones[1 - side] & (1ULL << cell))
                 {
-                    evaluation -= 5;
+                    zoneAttacks++;
                 }
-                break;
             }
-            case QUEEN:
+        }
+        else
+        {
+            int firstDirection = pieceType == ROOK ? 4 : 0;
+            int lastDirection = pieceType == BISHOP ? 4 : 8;
+            for (int direction = firstDirection; direction < lastDirection; direction++)
             {
-                if (pieceOwner == player)
+                for (int j = 0; j < rayLengths[i][direction]; j++)
                 {
-                    evaluation += 9;
-                }
-                else
-                {
-                    evaluation -= 9;
+                    uint8_t cell = rays[i][direction][j];
+                    if ((state->board[cell] & PIECE_OWNER_MASK) != owner && !(pawnAttacks[1 - side] & (1ULL << cell)))
+                    {
+                        mobility++;
+                    }
+                    if (kingZones[1 - side] & (1ULL << cell))
+                    {
+                        zoneAttacks++;
+                    }
+                    if (state->board[cell] != 0)
+                    {
+                        break;
+                    }
                 }
-                break;
             }
         }
+        *middlegame += sign * (mobility - mobilityBaseline[pieceType]) * mobilityMiddlegame[pieceType];
+        *endgame += sign * (mobility - mobilityBaseline[pieceType]) * mobilityEndgame[pieceType];
+        if (zoneAttacks > 0)
+        {
+            kingAttackers[side]++;
+            kingAttackUnits[side] += zoneAttacks * kingAttackWeights[pieceType];
+        }
+    }
+    for (int side = 0; side < 2; side++)
+    {
+        if (kingAttackers[side] >= 2)
+        {
+            int penalty = kingAttackUnits[side] * kingAttackUnits[side] / KING_ATTACK_SCALE;
+            if (penalty > MAX_KING_ATTACK_PENALTY)
+            {
+                penalty = MAX_KING_ATTACK_PENALTY;
+            }
+            *middlegame += side == 0 ? penalty : -penalty;
+        }
     }
-    return evaluation;
 }
 
-static int AISearch(int depth, GameState *state, int alpha, int beta)
+// Pawn structure scores cached by pawn hash.  Shared between threads the same way as the transposition table.
+static void probePawnTable(GameState *state, int *middlegame, int *endgame)
 {
-    if (depth == 0)
+    TTEntry *entry = &pawnTable[state->pawnHash & (PAWN_TABLE_SIZE - 1)];
+    uint64_t key = entry->key;
+    uint64_t data = entry->data;
+    if ((key ^ data) == state->pawnHash)
+    {
+        *middlegame = (int16_t)(data & 0xFFFF);
+        *endgame = (int16_t)((data >> 16) & 0xFFFF);
+        return;
+    }
+    evaluatePawnStructure(state, middlegame, endgame);
+    data = (uint16_t)*middlegame | ((uint64_t)(uint16_t)*endgame << 16);
+    entry->key = state->pawnHash ^ data;
+    entry->data = data;
+}
+
+// Blends the running middlegame and endgame scores, pawn structure and piece activity by game phase.
+static int classicalEvaluation(GameState *state)
+{
+    int pawnMiddlegame;
+    int pawnEndgame;
+    probePawnTable(state, &pawnMiddlegame, &pawnEndgame);
+    int activityMiddlegame;
+    int activityEndgame;
+    evaluatePieceActivity(state, &activityMiddlegame, &activityEndgame);
+    int middlegame = state->middlegameScore + pawnMiddlegame + activityMiddlegame;
+    int endgame = state->endgameScore + pawnEndgame + activityEndgame;
+    int phase = state->phase < MAX_PHASE ? state->phase : MAX_PHASE;
+    int evaluation = (middlegame * phase + endgame * (MAX_PHASE - phase)) / MAX_PHASE;
+    return state->playerToMove == WHITE ? evaluation : -evaluation;
+}
+
+/* Uses the neural network when one is loaded, otherwise the classical evaluation.  Checkmate and stalemate are detected by the search.
+   Results are cached by hash, shared between threads the same way as the transposition table. */
+static int AIEvaluate(GameState *state)
+{
+    TTEntry *entry = &evaluationCache[state->hash & (EVAL_CACHE_SIZE - 1)];
+    uint64_t key = entry->key;
+    uint64_t data = entry->data;
+    if ((key ^ data) == state->hash)
     {
-        return AIEvaluate(state);
+        return (int16_t)(data & 0xFFFF);
     }
-    uint16_t moves[1024];
-    int numMoves = getAllLegalMoves(moves, state);
-    if (numMoves <= 0)
+    int evaluation;
+    if (networkLoaded())
     {
-        if (playerInCheck(state))
-        {
-            return CHECKMATE_EVALUATION;
-        }
-        else
-        {
-            return STALEMATE_EVALUATION;
-        }
+        evaluation = evaluateNetwork(&state->accumulator, state->playerToMove);
     }
-    for (int i = 0; i < numMoves; i++)
+    else
     {
-        GameState copyState = *state;
-        movePiece(moves[i], &copyState);
-        int score = AISearch(depth - 1, &copyState, -beta, -alpha);
-        score = -score;
-        if (score >= beta)
-        {
-            return beta;
-        }
-        if (score > alpha)
-        {
-            alpha = score;
-        }
+        evaluation = classicalEvaluation(state);
     }
-    return alpha;
+    data = (uint16_t)evaluation;
+    entry->key = state->hash ^ data;
+    entry->data = data;
+    return evaluation;
 }
 
-uint16_t getComputerMove(void)
+// Forgets cached evaluations.  Called whenever the evaluation changes, such as loading a network.
+void clearEvaluationCache(void)
 {
-    uint16_t bestMoves[1024];
-    uint32_t numBestMoves = 0;
-    uint16_t moves[1024];
-    int numMoves = getAllLegalMoves(moves, &gameState);
-    int alpha = CHECKMATE_EVALUATION;
-    for (int i = 0 ; i < numMoves; i++)
+    memset(evaluationCache, 0, sizeof(evaluationCache));
+}
+
+// Null move pruning is unsafe in king and pawn endings where zugzwang is common.
+static bool hasNonPawnMaterial(GameState *state)
+{
+    uint8_t player = state->playerToMove;
+    for (int i = 0; i < 64; i++)
     {
-        GameState copyState = gameState;
-        movePiece(moves[i], &copyState);
-        int score = AISearch(3, &copyState, CHECKMATE_EVALUATION, -(alpha - 1));
-        score = -score;
-        if (score > alpha)
-        {
-            alpha = score;
-            bestMoves[0] = moves[i];
-            numBestMoves = 1;
-        }
-        else if (score == alpha)
+        uint8_t pieceType = state->board[i] & PIECE_TYPE_MASK;
+        if ((state->board[i] & PIECE_OWNER_MASK) == player && pieceType != PAWN && pieceType != KING)
         {
-            bestMoves[numBestMoves] = moves[i];
-            numBestMoves++;
+            return true;
         }
     }
+    return false;
+}
 
-    // Pick a move at random if multiple moves are tied for best evaluation.
-    // Helps stop AI from repeating moves.
-    if (numBestMoves == 0)
+static bool isQuietMove(uint16_t move, GameState *state)
+{
+    if (move & PAWN_PROMOTE_MASK)
     {
-        debugLog("getComputerMove: Did not find a move (this should never happen)");
+        return false;
+    }
+    if (state->board[move & MOVE_TO_MASK] != 0)
+    {
+        return false;
     }
-    return bestMoves[pcgRangedRandom(numBestMoves)];
+    uint8_t moveFrom = (move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
+    if ((move & CASTLE_ENPASSANT_FLAG) && (state->board[moveFrom] & PIECE_TYPE_MASK) == PAWN)
+    {
+        return false;
+    }
+    return true;
 }
 
-static void loadFenString(const char *str)
+static bool squareRemoved(uint8_t square, uint64_t removed)
 {
-    for (int i = 0; i < 64; i++)
-    {
-        gameState.board[i] = 0;
-    }
-    char c = *str;
-    int boardIndex = 0;
-    while (boardIndex < 64)
+    return (removed >> square) & 1;
+}
+
+/* Finds the least valuable piece of owner attacking square, ignoring pieces in the removed set.
+   Sliders are found by walking rays to the first piece still on the board,
+   so removing a piece from the front of a battery exposes the one behind it (x-ray). */
+static int leastValuableAttacker(uint8_t square, uint8_t owner, uint64_t removed, GameState *state)
+{
+    int col = square % 8;
+    int row = square / 8;
+    int pawnRow = owner == WHITE ? row + 1 : row - 1;
+    if (pawnRow >= 0 && pawnRow < 8)
     {
-        do
+        for (int dx = -1; dx <= 1; dx += 2)
         {
-            if (c == 'p')
-            {
-                gameState.board[boardIndex++] = BLACK | PAWN;
-            }
-            else if (c == 'n')
+            int x = col + dx;
+            if (x >= 0 && x < 8)
             {
-                gameState.board[boardIndex++] = BLACK | KNIGHT;
+                uint8_t cell = (pawnRow * 8) + x;
+                if (state->board[cell] == (owner | PAWN) && !squareRemoved(cell, removed))
+                {
+                    return cell;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < numKnightTargets[square]; i++)
+    {
+        uint8_t cell = knightTargets[square][i];
+        if (state->board[cell] == (owner | KNIGHT) && !squareRemoved(cell, removed))
+        {
+            return cell;
+        }
+    }
+    static const int directions[8][2] = {{-1, -1}, {1, -1}, {-1, 1}, {1, 1}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int bestAttacker = -1;
+    int bestValue = seeValues[KING];
+    for (int i = 0; i < 8; i++)
+    {
+        bool diagonal = i < 4;
+        int x = col + directions[i][0];
+        int y = row + directions[i][1];
+        while (x >= 0 && x < 8 && y >= 0 && y < 8)
+        {
+            uint8_t cell = (y * 8) + x;
+            if (state->board[cell] != 0 && !squareRemoved(cell, removed))
+            {
+                uint8_t pieceType = state->board[cell] & PIECE_TYPE_MASK;
+                if ((state->board[cell] & PIECE_OWNER_MASK) == owner && seeValues[pieceType] < bestValue
+                    && (pieceType == QUEEN || pieceType == (diagonal ? BISHOP : ROOK)))
+                {
+                    bestAttacker = cell;
+                    bestValue = seeValues[pieceType];
+                }
+                break;
+            }
+            x += directions[i][0];
+            y += directions[i][1];
+        }
+    }
+    if (bestAttacker != -1)
+    {
+        return bestAttacker;
+    }
+    for (int i = 0; i < numKingTargets[square]; i++)
+    {
+        uint8_t cell = kingTargets[square][i];
+        if (state->board[cell] == (owner | KING) && !squareRemoved(cell, removed))
+        {
+            return cell;
+        }
+    }
+    return -1;
+}
+
+/* Static exchange evaluation.  Plays out all captures on the destination square,
+   each side always recapturing with its least valuable piece and free to stop when that's better.
+   Returns the expected material gain for the moving side.  Ignores pins. */
+static int staticExchangeEvaluation(uint16_t move, GameState *state)
+{
+    uint8_t moveTo = move & MOVE_TO_MASK;
+    uint8_t moveFrom = (move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
+    uint8_t piece = state->board[moveFrom];
+    uint8_t owner = piece & PIECE_OWNER_MASK;
+    int gain[32];
+    int numGain = 0;
+    uint64_t removed = (uint64_t)1 << moveFrom;
+    int capturedValue = seeValues[state->board[moveTo] & PIECE_TYPE_MASK];
+    int attackerValue = seeValues[piece & PIECE_TYPE_MASK];
+    if ((move & CASTLE_ENPASSANT_FLAG) && (piece & PIECE_TYPE_MASK) == PAWN)
+    {
+        capturedValue = seeValues[PAWN];
+        removed |= (uint64_t)1 << (owner == WHITE ? moveTo + 8 : moveTo - 8);
+    }
+    gain[numGain++] = capturedValue;
+    if (move & PAWN_PROMOTE_MASK)
+    {
+        attackerValue = seeValues[(move & PAWN_PROMOTE_MASK) >> PAWN_PROMOTE_SHIFT];
+        gain[0] += attackerValue - seeValues[PAWN];
+    }
+    uint8_t side = owner == WHITE ? BLACK : WHITE;
+    while (numGain < 32)
+    {
+        int attacker = leastValuableAttacker(moveTo, side, removed, state);
+        if (attacker == -1)
+        {
+            break;
+        }
+        // Speculative gain if the piece that just moved gets captured.
+        gain[numGain] = attackerValue - gain[numGain - 1];
+        numGain++;
+        removed |= (uint64_t)1 << attacker;
+        attackerValue = seeValues[state->board[attacker] & PIECE_TYPE_MASK];
+        side = side == WHITE ? BLACK : WHITE;
+    }
+    // Walk back through the sequence letting each side stop capturing if that's better for them.
+    while (numGain > 1)
+    {
+        numGain--;
+        if (gain[numGain] > -gain[numGain - 1])
+        {
+            gain[numGain - 1] = -gain[numGain];
+        }
+    }
+    return gain[0];
+}
+
+// Ranks captures and promotions by most valuable victim, then least valuable attacker.
+static int captureScore(uint16_t move, GameState *state)
+{
+    uint8_t victimType = state->board[move & MOVE_TO_MASK] & PIECE_TYPE_MASK;
+    uint8_t attackerType = state->board[(move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT] & PIECE_TYPE_MASK;
+    int score = seeValues[victimType] * 8 - seeValues[attackerType] / 100;
+    if (move & PAWN_PROMOTE_MASK)
+    {
+        score += seeValues[(move & PAWN_PROMOTE_MASK) >> PAWN_PROMOTE_SHIFT] * 8;
+    }
+    else if (victimType == 0)
+    {
+        score += seeValues[PAWN] * 8;
+    }
+    return score;
+}
+
+static void sortMoves(uint16_t *moves, int *scores, int numMoves)
+{
+    for (int i = 1; i < numMoves; i++)
+    {
+        uint16_t move = moves[i];
+        int score = scores[i];
+        int j = i - 1;
+        while (j >= 0 && scores[j] < score)
+        {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+            j--;
+        }
+        moves[j + 1] = move;
+        scores[j + 1] = score;
+    }
+}
+
+static void updateHistory(int *history, int bonus)
+{
+    // Gravity formula keeps history scores between -HISTORY_MAX and HISTORY_MAX without needing to age the table.
+    *history += bonus - (*history * abs(bonus) / HISTORY_MAX);
+}
+
+static void orderMoves(uint16_t *moves, int numMoves, int ply, uint16_t previousMove, uint16_t hashMove, SearchData *data, GameState *state)
+{
+    /* Order moves putting possible best moves first.
+       This improves AI search performance with alpha-beta pruning.
+       Doesn't actually change results.  It's just a guess. */
+    int scores[1024];
+    uint16_t counterMove = 0;
+    if (previousMove != 0)
+    {
+        counterMove = data->counterMoves[(previousMove & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT][previousMove & MOVE_TO_MASK];
+    }
+    int side = state->playerToMove == WHITE ? 0 : 1;
+    for (int i = 0; i < numMoves; i++)
+    {
+        uint16_t moveTo = moves[i] & MOVE_TO_MASK;
+        uint16_t moveFrom = (moves[i] & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
+        if (moves[i] == hashMove)
+        {
+            scores[i] = 8 * HISTORY_MAX;
+        }
+        else if (!isQuietMove(moves[i], state))
+        {
+            // Captures that lose material go after all quiet moves.
+            if (staticExchangeEvaluation(moves[i], state) >= 0)
+            {
+                scores[i] = 4 * HISTORY_MAX + captureScore(moves[i], state);
+            }
+            else
+            {
+                scores[i] = -2 * HISTORY_MAX + captureScore(moves[i], state);
+            }
+        }
+        else if (moves[i] == data->killerMoves[ply][0])
+        {
+            scores[i] = 3 * HISTORY_MAX + 2;
+        }
+        else if (moves[i] == data->killerMoves[ply][1])
+        {
+            scores[i] = 3 * HISTORY_MAX + 1;
+        }
+        else if (moves[i] == counterMove)
+        {
+            scores[i] = 3 * HISTORY_MAX;
+        }
+        else
+        {
+            scores[i] = data->history[side][moveFrom][moveTo];
+        }
+    }
+    sortMoves(moves, scores, numMoves);
+}
+
+// Rewards a quiet move that caused a beta cutoff and penalizes the quiet moves searched before it.
+static void updateQuietMoveStats(uint16_t move, uint16_t *quietMoves, int numQuietMoves, int depth, int ply, uint16_t previousMove, SearchData *data, GameState *state)
+{
+    if (data->killerMoves[ply][0] != move)
+    {
+        data->killerMoves[ply][1] = data->killerMoves[ply][0];
+        data->killerMoves[ply][0] = move;
+    }
+    if (previousMove != 0)
+    {
+        data->counterMoves[(previousMove & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT][previousMove & MOVE_TO_MASK] = move;
+    }
+    int side = state->playerToMove == WHITE ? 0 : 1;
+    int bonus = depth * depth;
+    updateHistory(&data->history[side][(move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT][move & MOVE_TO_MASK], bonus);
+    for (int i = 0; i < numQuietMoves; i++)
+    {
+        updateHistory(&data->history[side][(quietMoves[i] & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT][quietMoves[i] & MOVE_TO_MASK], -bonus);
+    }
+}
+
+static bool searchStopped(SearchData *data)
+{
+    return data->stopped;
+}
+
+// Counts a node and every STOP_CHECK_NODES nodes checks whether the search has to stop.
+static void countNode(SearchData *data)
+{
+    data->nodes++;
+    if ((data->nodes & (STOP_CHECK_NODES - 1)) != 0)
+    {
+        return;
+    }
+    const SearchLimits *limits = data->limits;
+    if (limits->stop != NULL && *limits->stop)
+    {
+        data->stopped = true;
+    }
+    else if (limits->nodes > 0 && data->nodes >= limits->nodes)
+    {
+        data->stopped = true;
+    }
+    else if (limits->time > 0 && getTime() - data->startTime >= limits->time)
+    {
+        data->stopped = true;
+    }
+}
+
+/* Only searches captures and promotions (or every move when in check) so the
+   evaluation is never taken in the middle of an exchange.  Captures that lose
+   material by static exchange evaluation are skipped. */
+static int quiescenceSearch(int ply, GameState *state, int alpha, int beta, SearchData *data)
+{
+    countNode(data);
+    uint16_t moves[1024];
+    int numMoves = getAllLegalMoves(moves, state);
+    bool inCheck = playerInCheck(state);
+    if (numMoves <= 0)
+    {
+        if (inCheck)
+        {
+            return CHECKMATE_EVALUATION + ply;
+        }
+        else
+        {
+            return STALEMATE_EVALUATION;
+        }
+    }
+    if (ply >= MAX_SEARCH_DEPTH - 1)
+    {
+        return AIEvaluate(state);
+    }
+    int scores[1024];
+    int numSearchMoves = 0;
+    for (int i = 0; i < numMoves; i++)
+    {
+        if (inCheck)
+        {
+            scores[numSearchMoves] = isQuietMove(moves[i], state) ? 0 : captureScore(moves[i], state);
+            moves[numSearchMoves++] = moves[i];
+        }
+        else if (!isQuietMove(moves[i], state) && staticExchangeEvaluation(moves[i], state) >= 0)
+        {
+            scores[numSearchMoves] = captureScore(moves[i], state);
+            moves[numSearchMoves++] = moves[i];
+        }
+    }
+    // Stand pat.  The side to move can usually do at least as well as the static evaluation by not capturing.
+    if (!inCheck)
+    {
+        int evaluation = AIEvaluate(state);
+        if (evaluation >= beta)
+        {
+            return beta;
+        }
+        if (evaluation > alpha)
+        {
+            alpha = evaluation;
+        }
+    }
+    sortMoves(moves, scores, numSearchMoves);
+    for (int i = 0; i < numSearchMoves; i++)
+    {
+        GameState copyState;
+        copyGameState(&copyState, state);
+        movePiece(moves[i], &copyState);
+        int score = -quiescenceSearch(ply + 1, &copyState, -beta, -alpha, data);
+        if (searchStopped(data))
+        {
+            return 0;
+        }
+        if (score >= beta)
+        {
+            return beta;
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+        }
+    }
+    return alpha;
+}
+
+/* Transposition table entries are shared between search threads without locking.
+   The key is stored XORed with the data so an entry torn by two threads writing at once
+   fails the key check instead of returning another position's data. */
+/* Mate scores are stored relative to the node rather than the root,
+   so they stay correct when the position is reached at a different ply. */
+static int scoreToTranspositionTable(int score, int ply)
+{
+    if (score >= MATE_THRESHOLD)
+    {
+        return score + ply;
+    }
+    if (score <= -MATE_THRESHOLD)
+    {
+        return score - ply;
+    }
+    return score;
+}
+
+static int scoreFromTranspositionTable(int score, int ply)
+{
+    if (score >= MATE_THRESHOLD)
+    {
+        return score - ply;
+    }
+    if (score <= -MATE_THRESHOLD)
+    {
+        return score + ply;
+    }
+    return score;
+}
+
+static bool probeTranspositionTable(uint64_t hash, int ply, uint16_t *move, int *score, int *depth, int *bound)
+{
+    TTEntry *entry = &transpositionTable[hash & transpositionTableMask];
+    uint64_t key = entry->key;
+    uint64_t data = entry->data;
+    if ((key ^ data) != hash)
+    {
+        return false;
+    }
+    *move = data & 0xFFFF;
+    *score = scoreFromTranspositionTable((int16_t)((data >> 16) & 0xFFFF), ply);
+    *depth = (data >> 32) & 0xFF;
+    *bound = (data >> 40) & 3;
+    return true;
+}
+
+static void storeTranspositionTable(uint64_t hash, int ply, uint16_t move, int score, int depth, int bound)
+{
+    TTEntry *entry = &transpositionTable[hash & transpositionTableMask];
+    uint64_t oldData = entry->data;
+    // Keep deeper results for the same position unless the new one is exact.
+    if ((entry->key ^ oldData) == hash && bound != TT_EXACT && (int)((oldData >> 32) & 0xFF) > depth)
+    {
+        return;
+    }
+    if (move == 0 && (entry->key ^ oldData) == hash)
+    {
+        move = oldData & 0xFFFF;
+    }
+    score = scoreToTranspositionTable(score, ply);
+    uint64_t data = move | ((uint64_t)(uint16_t)score << 16) | ((uint64_t)depth << 32) | ((uint64_t)bound << 40);
+    entry->key = hash ^ data;
+    entry->data = data;
+}
+
+/* True if the position already occurred in the search path or the game.
+   Only every other position since the last capture or pawn move can match. */
+static bool isRepetition(int ply, GameState *state, SearchData *data)
+{
+    for (int i = 4; i <= state->halfMoves && i <= ply; i += 2)
+    {
+        if (data->hashStack[ply - i] == state->hash)
+        {
+            return true;
+        }
+    }
+    if (state->halfMoves > ply)
+    {
+        for (int i = 0; i < data->numGameHashes; i++)
+        {
+            if (data->gameHashes[i] == state->hash)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* Remaining depth after a move from this ply.  Giving check and having only one legal reply
+   earn fractions of a ply, which add up along the path until the extension budget is spent. */
+static int extendedDepth(int depth, int ply, bool givesCheck, bool singleReply, SearchData *data)
+{
+    int extension = data->extensions[ply];
+    if (givesCheck)
+    {
+        extension += CHECK_EXTENSION;
+    }
+    if (singleReply)
+    {
+        extension += SINGLE_REPLY_EXTENSION;
+    }
+    if (extension > MAX_EXTENSION)
+    {
+        extension = MAX_EXTENSION;
+    }
+    data->extensions[ply + 1] = extension;
+    return depth - 1 + extension / ONE_PLY - data->extensions[ply] / ONE_PLY;
+}
+
+// previousMove is 0 directly after a null move.  Null moves are never made twice in a row.
+static int AISearch(int depth, int ply, GameState *state, int alpha, int beta, uint16_t previousMove, SearchData *data)
+{
+    countNode(data);
+    // Twofold repetition is scored as a draw.  Playing on can't gain anything the first time didn't.
+    if (isRepetition(ply, state, data))
+    {
+        return STALEMATE_EVALUATION;
+    }
+    if (depth <= 0 || ply >= MAX_SEARCH_DEPTH - 1)
+    {
+        return quiescenceSearch(ply, state, alpha, beta, data);
+    }
+    data->hashStack[ply] = state->hash;
+    if (searchStopped(data))
+    {
+        return 0;
+    }
+    // Mate distance pruning.  Nothing here can beat being mated now or mating on the next move.
+    if (alpha < CHECKMATE_EVALUATION + ply)
+    {
+        alpha = CHECKMATE_EVALUATION + ply;
+    }
+    if (beta > -CHECKMATE_EVALUATION - ply - 1)
+    {
+        beta = -CHECKMATE_EVALUATION - ply - 1;
+    }
+    if (alpha >= beta)
+    {
+        return alpha;
+    }
+    uint16_t hashMove = 0;
+    int hashScore;
+    int hashDepth;
+    int hashBound;
+    if (probeTranspositionTable(state->hash, ply, &hashMove, &hashScore, &hashDepth, &hashBound) && hashDepth >= depth)
+    {
+        if (hashBound == TT_EXACT)
+        {
+            if (hashScore >= beta)
+            {
+                return beta;
+            }
+            if (hashScore <= alpha)
+            {
+                return alpha;
+            }
+            return hashScore;
+        }
+        if (hashBound == TT_LOWER && hashScore >= beta)
+        {
+            return beta;
+        }
+        if (hashBound == TT_UPPER && hashScore <= alpha)
+        {
+            return alpha;
+        }
+    }
+    bool inCheck = playerInCheck(state);
+    // Null move pruning.  If passing the turn still fails high with a reduced search, a real move almost certainly will too.
+    if (previousMove != 0 && !inCheck && depth >= NULL_MOVE_MIN_DEPTH && beta - alpha == 1 && hasNonPawnMaterial(state))
+    {
+        GameState copyState;
+        copyGameState(&copyState, state);
+        makeNullMove(&copyState);
+        int score = -AISearch(extendedDepth(depth - NULL_MOVE_REDUCTION, ply, false, false, data), ply + 1, &copyState, -beta, -beta + 1, 0, data);
+        if (searchStopped(data))
+        {
+            return 0;
+        }
+        if (score >= beta)
+        {
+            return beta;
+        }
+    }
+    // Futility pruning and razoring only apply to null window nodes near the leaves that aren't deciding a mate.
+    bool futile = false;
+    if (!inCheck && depth <= 2 && beta - alpha == 1 && alpha > -MATE_THRESHOLD && beta < MATE_THRESHOLD)
+    {
+        int evaluation = AIEvaluate(state);
+        // Razoring.  Far enough below alpha that only captures could save the position, so let quiescence decide.
+        if (depth <= RAZOR_DEPTH && evaluation + RAZOR_MARGIN <= alpha)
+        {
+            int score = quiescenceSearch(ply, state, alpha, beta, data);
+            if (searchStopped(data))
+            {
+                return 0;
+            }
+            if (score <= alpha)
+            {
+                return alpha;
+            }
+        }
+        // Quiet moves at the frontier can't gain more than the margin before quiescence takes over.
+        // One ply further back, a larger margin covers the opponent's reply as well.
+        futile = evaluation + (depth == 1 ? FUTILITY_MARGIN : EXTENDED_FUTILITY_MARGIN) <= alpha;
+    }
+    uint16_t moves[1024];
+    int numMoves = getAllLegalMoves(moves, state);
+    if (numMoves <= 0)
+    {
+        if (inCheck)
+        {
+            return CHECKMATE_EVALUATION + ply;
+        }
+        else
+        {
+            return STALEMATE_EVALUATION;
+        }
+    }
+    orderMoves(moves, numMoves, ply, previousMove, hashMove, data, state);
+    int originalAlpha = alpha;
+    uint16_t bestMove = 0;
+    uint16_t quietMoves[1024];
+    int numQuietMoves = 0;
+    for (int i = 0; i < numMoves; i++)
+    {
+        GameState copyState;
+        copyGameState(&copyState, state);
+        movePiece(moves[i], &copyState);
+        bool quietMove = isQuietMove(moves[i], state);
+        bool givesCheck = playerInCheck(&copyState);
+        if (futile && i > 0 && quietMove && !givesCheck)
+        {
+            continue;
+        }
+        int newDepth = extendedDepth(depth, ply, givesCheck, numMoves == 1, data);
+        int score;
+        if (i == 0)
+        {
+            score = -AISearch(newDepth, ply + 1, &copyState, -beta, -alpha, moves[i], data);
+        }
+        else
+        {
+            // Late move reductions.  Moves this far down the ordering rarely turn out best,
+            // so quiet ones get a shallower search first and are only searched fully if they beat alpha.
+            int reduction = 0;
+            if (depth >= LMR_MIN_DEPTH && i >= LMR_MIN_MOVES && !inCheck && quietMove && !givesCheck)
+            {
+                reduction = lateMoveReductions[depth < MAX_SEARCH_DEPTH ? depth : MAX_SEARCH_DEPTH - 1][i < 64 ? i : 63];
+                if (reduction > newDepth)
+                {
+                    reduction = newDepth;
+                }
+            }
+            // Principal variation search.  Assume the first move was the best and only prove
+            // the rest can't beat alpha with a null window.  Re-search if that guess was wrong.
+            score = -AISearch(newDepth - reduction, ply + 1, &copyState, -alpha - 1, -alpha, moves[i], data);
+            if (reduction > 0 && score > alpha)
+            {
+                score = -AISearch(newDepth, ply + 1, &copyState, -alpha - 1, -alpha, moves[i], data);
+            }
+            if (score > alpha && score < beta)
+            {
+                score = -AISearch(newDepth, ply + 1, &copyState, -beta, -alpha, moves[i], data);
+            }
+        }
+        if (searchStopped(data))
+        {
+            return 0;
+        }
+        if (score >= beta)
+        {
+            if (quietMove)
+            {
+                updateQuietMoveStats(moves[i], quietMoves, numQuietMoves, depth, ply, previousMove, data, state);
+            }
+            storeTranspositionTable(state->hash, ply, moves[i], beta, depth, TT_LOWER);
+            return beta;
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+            bestMove = moves[i];
+        }
+        if (quietMove)
+        {
+            quietMoves[numQuietMoves++] = moves[i];
+        }
+    }
+    storeTranspositionTable(state->hash, ply, bestMove, alpha, depth, alpha > originalAlpha ? TT_EXACT : TT_UPPER);
+    return alpha;
+}
+
+/* Searches all root moves with principal variation search.  Sets bestMove to the move that raised alpha.
+   Returns alpha if no move beat it or beta if a move reached beta, otherwise returns the best score. */
+static int AISearchRoot(int depth, uint16_t *moves, int numMoves, int alpha, int beta, uint16_t *bestMove, SearchData *data, GameState *state)
+{
+    for (int i = 0; i < numMoves; i++)
+    {
+        GameState copyState;
+        copyGameState(&copyState, state);
+        movePiece(moves[i], &copyState);
+        int newDepth = extendedDepth(depth, 0, playerInCheck(&copyState), numMoves == 1, data);
+        int score;
+        if (i == 0)
+        {
+            score = -AISearch(newDepth, 1, &copyState, -beta, -alpha, moves[i], data);
+        }
+        else
+        {
+            score = -AISearch(newDepth, 1, &copyState, -alpha - 1, -alpha, moves[i], data);
+            if (score > alpha && score < beta)
+            {
+                score = -AISearch(newDepth, 1, &copyState, -beta, -alpha, moves[i], data);
+            }
+        }
+        if (searchStopped(data))
+        {
+            return 0;
+        }
+        if (score >= beta)
+        {
+            *bestMove = moves[i];
+            return beta;
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+            *bestMove = moves[i];
+        }
+    }
+    return alpha;
+}
+
+// The reply we expect from the opponent: the hash move stored for the position, if it is legal.
+static uint16_t expectedReply(GameState *state)
+{
+    uint16_t hashMove;
+    int score, depth, bound;
+    if (!probeTranspositionTable(state->hash, 0, &hashMove, &score, &depth, &bound) || hashMove == 0)
+    {
+        return 0;
+    }
+    uint16_t moves[1024];
+    int numMoves = getAllLegalMoves(moves, state);
+    for (int i = 0; i < numMoves; i++)
+    {
+        if (moves[i] == hashMove)
+        {
+            return hashMove;
+        }
+    }
+    return 0;
+}
+
+// Follows hash moves from the position after move.  Returns the number of moves in the line.
+static int principalVariation(uint16_t move, const GameState *state, int maxLength, uint16_t *pv)
+{
+    GameState copyState = *state;
+    int length = 0;
+    while (length < maxLength && move != 0)
+    {
+        pv[length++] = move;
+        movePiece(move, &copyState);
+        move = expectedReply(&copyState);
+    }
+    return length;
+}
+
+// Moves to mate for the side to move, negative when being mated.  0 if the score isn't a mate.
+static int mateDistance(int score)
+{
+    if (score >= MATE_THRESHOLD)
+    {
+        return (-CHECKMATE_EVALUATION - score + 1) / 2;
+    }
+    if (score <= -MATE_THRESHOLD)
+    {
+        return -((-CHECKMATE_EVALUATION + score) / 2);
+    }
+    return 0;
+}
+
+// Passes the iteration the main thread just completed to the search's report callback.
+static void reportIteration(SearchThread *thread)
+{
+    SearchInfo info;
+    info.depth = thread->completedDepth;
+    info.score = thread->bestScore;
+    info.mate = mateDistance(thread->bestScore);
+    info.nodes = 0;
+    for (int i = 0; i < thread->numThreads; i++)
+    {
+        info.nodes += thread[i].data.nodes;
+    }
+    info.time = getTime() - thread->data.startTime;
+    int maxLength = thread->completedDepth < MAX_PV_LENGTH ? thread->completedDepth : MAX_PV_LENGTH;
+    info.pvLength = principalVariation(thread->bestMove, &thread->state, maxLength, info.pv);
+    info.terminal = false;
+    thread->data.limits->report(&info);
+}
+
+static void iterativeDeepening(SearchThread *thread)
+{
+    if (thread->numMoves == 0)
+    {
+        // Checkmate or stalemate.  There's nothing to search and no move to report.
+        thread->bestScore = playerInCheck(&thread->state) ? CHECKMATE_EVALUATION : 0;
+        return;
+    }
+    int score = 0;
+    // Helper threads start on alternating depths so they aren't all searching the same tree at the same time.
+    for (int depth = 1 + (thread->id % 2); depth <= thread->maxDepth; depth++)
+    {
+        int alpha = CHECKMATE_EVALUATION;
+        int beta = -CHECKMATE_EVALUATION + 1;
+        int window = ASPIRATION_WINDOW;
+        if (depth > 1)
+        {
+            alpha = score - window > CHECKMATE_EVALUATION ? score - window : CHECKMATE_EVALUATION;
+            beta = score + window < -CHECKMATE_EVALUATION + 1 ? score + window : -CHECKMATE_EVALUATION + 1;
+        }
+        uint16_t bestMove = 0;
+        while (true)
+        {
+            score = AISearchRoot(depth, thread->moves, thread->numMoves, alpha, beta, &bestMove, &thread->data, &thread->state);
+            if (searchStopped(&thread->data))
+            {
+                return;
+            }
+            window *= 4;
+            if (score <= alpha && alpha > CHECKMATE_EVALUATION)
+            {
+                alpha = score - window;
+                if (alpha < CHECKMATE_EVALUATION)
+                {
+                    alpha = CHECKMATE_EVALUATION;
+                }
+            }
+            else if (score >= beta)
+            {
+                beta = score + window;
+                if (beta > -CHECKMATE_EVALUATION + 1)
+                {
+                    beta = -CHECKMATE_EVALUATION + 1;
+                }
+            }
+            else
+            {
+                break;
+            }
+        }
+        for (int i = 0; i < thread->numMoves; i++)
+        {
+            if (thread->moves[i] == bestMove)
+            {
+                memmove(thread->moves + 1, thread->moves, i * sizeof(uint16_t));
+                thread->moves[0] = bestMove;
+                break;
+            }
+        }
+        thread->bestMove = bestMove;
+        thread->bestScore = score;
+        thread->completedDepth = depth;
+        if (thread->data.limits->report != NULL)
+        {
+            reportIteration(thread);
+        }
+    }
+}
+
+/* Variety.  Every root move that scores within the margin of the best move at the last completed depth
+   is found with one null window search each, mostly answered by the transposition table.
+   One of them is picked at random.  Helps stop AI from repeating moves.
+   A margin of 0 still picks between moves that tie the best, which keeps games from repeating at the default. */
+static uint16_t pickVarietyMove(SearchThread *thread, int margin, RngState *rng)
+{
+    if (margin < 0 || thread->bestScore >= MATE_THRESHOLD)
+    {
+        return thread->bestMove;
+    }
+    uint16_t candidates[1024];
+    candidates[0] = thread->bestMove;
+    int numCandidates = 1;
+    int threshold = thread->bestScore - margin;
+    for (int i = 0; i < thread->numMoves; i++)
+    {
+        if (thread->moves[i] == thread->bestMove)
+        {
+            continue;
+        }
+        GameState copyState;
+        copyGameState(&copyState, &thread->state);
+        movePiece(thread->moves[i], &copyState);
+        int newDepth = extendedDepth(thread->completedDepth, 0, playerInCheck(&copyState), false, &thread->data);
+        int score = -AISearch(newDepth, 1, &copyState, -threshold, -threshold + 1, thread->moves[i], &thread->data);
+        if (searchStopped(&thread->data))
+        {
+            return thread->bestMove;
+        }
+        if (score >= threshold)
+        {
+            candidates[numCandidates++] = thread->moves[i];
+        }
+    }
+    return candidates[pcgRangedRandom(numCandidates, rng)];
+}
+
+static void *helperSearchThread(void *arg)
+{
+    iterativeDeepening(arg);
+    return NULL;
+}
+
+/* Lazy SMP.  Helper threads search the same position with their own move ordering
+   and share what they find through the transposition table.
+   Only the main thread's result is used.  With one thread the search is deterministic. */
+static uint16_t searchPosition(GameState *state, const uint64_t *history, int historyLength, const SearchLimits *limits, RngState *rng)
+{
+    SearchThread *threads = calloc(numSearchThreads, sizeof(SearchThread));
+    if (threads == NULL)
+    {
+        debugLog("searchPosition: calloc failed");
+        return 0;
+    }
+    volatile bool stopHelpers = false;
+    SearchLimits helperLimits = {MAX_SEARCH_DEPTH - 1, 0, 0, &stopHelpers, 0, NULL};
+    uint64_t startTime = getTime();
+    void *helperHandles[MAX_SEARCH_THREADS];
+    int numHelpers = 0;
+    for (int i = 0; i < numSearchThreads; i++)
+    {
+        SearchThread *thread = &threads[i];
+        thread->id = i;
+        thread->state = *state;
+        thread->data.hashStack[0] = state->hash;
+        memcpy(thread->data.gameHashes, history, historyLength * sizeof(uint64_t));
+        thread->data.numGameHashes = historyLength;
+        thread->data.startTime = startTime;
+        thread->numMoves = getAllLegalMoves(thread->moves, &thread->state);
+        orderMoves(thread->moves, thread->numMoves, 0, 0, 0, &thread->data, &thread->state);
+        if (i == 0)
+        {
+            thread->maxDepth = limits->depth > 0 && limits->depth < MAX_SEARCH_DEPTH ? limits->depth : SEARCH_DEPTH;
+            thread->data.limits = limits;
+            thread->numThreads = numSearchThreads;
+            continue;
+        }
+        // Rotate the root moves so each helper starts on a different one.
+        for (int j = 0; thread->numMoves > 0 && j < i % thread->numMoves; j++)
+        {
+            uint16_t first = thread->moves[0];
+            memmove(thread->moves, thread->moves + 1, (thread->numMoves - 1) * sizeof(uint16_t));
+            thread->moves[thread->numMoves - 1] = first;
+        }
+        thread->maxDepth = helperLimits.depth;
+        thread->data.limits = &helperLimits;
+        void *handle = createThread(helperSearchThread, thread);
+        if (handle != NULL)
+        {
+            helperHandles[numHelpers++] = handle;
+        }
+    }
+    iterativeDeepening(&threads[0]);
+    stopHelpers = true;
+    for (int i = 0; i < numHelpers; i++)
+    {
+        joinThread(helperHandles[i]);
+    }
+    uint16_t move;
+    if (threads[0].completedDepth == 0)
+    {
+        // Stopped before the first iteration finished.  Play the first move in the ordering.
+        move = threads[0].numMoves > 0 ? threads[0].moves[0] : 0;
+    }
+    else
+    {
+        move = pickVarietyMove(&threads[0], limits->variety, rng);
+    }
+    free(threads);
+    return move;
+}
+
+static void *ponderThread(void *arg)
+{
+    PonderSearch *ponder = arg;
+    ponder->move = searchPosition(&ponder->state, ponder->history, ponder->historyLength, &ponder->limits, &ponder->rng);
+    return NULL;
+}
+
+/* Pondering.  While the player thinks we search the position after the reply we expect.
+   If they play it the result is ready (or nearly so).  If not the search is stopped
+   and everything it stored in the transposition table is still there for the real one. */
+void startPondering(void)
+{
+    stopPondering();
+    uint16_t reply = expectedReply(&gameState);
+    if (reply == 0)
+    {
+        return;
+    }
+    ponderSearch.state = gameState;
+    movePiece(reply, &ponderSearch.state);
+    ponderSearch.historyLength = collectGameHistory(ponderSearch.history);
+    ponderSearch.limits = searchLimits;
+    ponderSearch.rng.state = pcgGetRandom64(&rngState);
+    ponderSearch.rng.inc = pcgGetRandom64(&rngState) | 1;
+    ponderSearch.limits.stop = &ponderSearch.stop;
+    ponderSearch.stop = false;
+    ponderSearch.thread = createThread(ponderThread, &ponderSearch);
+}
+
+void stopPondering(void)
+{
+    if (ponderSearch.thread != NULL)
+    {
+        ponderSearch.stop = true;
+        joinThread(ponderSearch.thread);
+        ponderSearch.thread = NULL;
+    }
+}
+
+uint16_t getComputerMove(void)
+{
+    if (ponderSearch.thread != NULL)
+    {
+        if (ponderSearch.state.hash == gameState.hash)
+        {
+            // Ponder hit.  Let the search finish and play its move.
+            joinThread(ponderSearch.thread);
+            ponderSearch.thread = NULL;
+            if (ponderSearch.move != 0)
+            {
+                return ponderSearch.move;
+            }
+        }
+        stopPondering();
+    }
+    uint16_t moves[1024];
+    if (getAllLegalMoves(moves, &gameState) == 0)
+    {
+        // Checkmate or stalemate.  There's no move to find, only the result to report.
+        if (searchLimits.report != NULL)
+        {
+            SearchInfo info;
+            memset(&info, 0, sizeof(info));
+            info.score = playerInCheck(&gameState) ? CHECKMATE_EVALUATION : STALEMATE_EVALUATION;
+            info.terminal = true;
+            searchLimits.report(&info);
+        }
+        return 0;
+    }
+    uint64_t history[MAX_GAME_HASHES];
+    int historyLength = collectGameHistory(history);
+    SearchLimits limits = searchLimits;
+    limits.stop = &searchAborted;
+    uint16_t move = searchPosition(&gameState, history, historyLength, &limits, &rngState);
+    if (move == 0)
+    {
+        debugLog("getComputerMove: Did not find a move (this should never happen)");
+    }
+    return move;
+}
+
+// Aborts the search in progress.  getComputerMove returns the best move found so far.
+void stopSearch(void)
+{
+    searchAborted = true;
+    ponderSearch.stop = true;
+}
+
+/* A depth of 0 means the default depth.  A node or time (milliseconds) limit of 0 means no limit.
+   Also clears the last search's stop, so it must be called before starting a search on another thread.
+   Clearing it in the search itself would lose a stop sent before the thread got going. */
+void setSearchLimits(int depth, uint64_t nodes, uint64_t time)
+{
+    searchAborted = false;
+    searchLimits.depth = depth > 0 ? depth : SEARCH_DEPTH;
+    searchLimits.nodes = nodes;
+    searchLimits.time = time;
+}
+
+// Reporting each completed depth of the search.  NULL for none.
+void setSearchReport(SearchReport report)
+{
+    searchLimits.report = report;
+}
+
+/* Replaces the transposition table with an empty one of the largest power of 2 entries that fits in megabytes.
+   Must not be called during a search.  Keeps the old table if the memory can't be allocated. */
+bool setHashSize(int megabytes)
+{
+    uint64_t entries = 1;
+    while (entries * 2 * sizeof(TTEntry) <= (uint64_t)megabytes * 1024 * 1024)
+    {
+        entries *= 2;
+    }
+    TTEntry *table = calloc(entries, sizeof(TTEntry));
+    if (table == NULL)
+    {
+        debugLog("setHashSize: calloc failed");
+        return false;
+    }
+    free(transpositionTable);
+    transpositionTable = table;
+    transpositionTableMask = entries - 1;
+    return true;
+}
+
+// Forgets everything the previous searches stored.  Must not be called during a search.
+void clearHash(void)
+{
+    memset(transpositionTable, 0, (transpositionTableMask + 1) * sizeof(TTEntry));
+}
+
+void setSearchThreads(int threads)
+{
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    if (threads > MAX_SEARCH_THREADS)
+    {
+        threads = MAX_SEARCH_THREADS;
+    }
+    numSearchThreads = threads;
+}
+
+void loadFenString(const char *str)
+{
+    for (int i = 0; i < 64; i++)
+    {
+        gameState.board[i] = 0;
+    }
+    char c = *str;
+    int boardIndex = 0;
+    while (boardIndex < 64)
+    {
+        do
+        {
+            if (c == 'p')
+            {
+                gameState.board[boardIndex++] = BLACK | PAWN;
+            }
+            else if (c == 'n')
+            {
+                gameState.board[boardIndex++] = BLACK | KNIGHT;
             }
             else if (c == 'b')
             {
@@ -1268,10 +2678,10 @@ static void loadFenString(const char *str)
     }
     str++;
     c = *str;
-    gameState.enPassantSquare = 0;
+    gameState.enPassantSquare = 255;
     if (c != '-')
     {
-        gameState.enPassantSquare += c - 97;
+        gameState.enPassantSquare = c - 97;
         str++;
         c = *str;
         gameState.enPassantSquare += 56 - ((c - 49) * 8);
@@ -1280,7 +2690,7 @@ static void loadFenString(const char *str)
     c = *str;
     char halfMoveString[8];
     int i = 0;
-    while (c != ' ')
+    while (c != ' ' && c != 0 && i < 7)
     {
         halfMoveString[i++] = c;
         str++;
@@ -1290,23 +2700,73 @@ static void loadFenString(const char *str)
     gameState.halfMoves = atoi(halfMoveString);
 
     hashStartingPosition();
+    scorePosition(&gameState);
 }
 
 void initZobrist(void)
 {
     for (int i = 0; i < 768; i++)
     {
-        zobrist.pieces[i] = pcgGetRandom64();
+        zobrist.pieces[i] = pcgGetRandom64(&rngState);
     }
     for (int i = 0; i < 8; i++)
     {
-        zobrist.enPassantFile[i] = pcgGetRandom64();
+        zobrist.enPassantFile[i] = pcgGetRandom64(&rngState);
+    }
+    zobrist.playerToMove = pcgGetRandom64(&rngState);
+    zobrist.blackQueenCastle = pcgGetRandom64(&rngState);
+    zobrist.whiteQueenCastle = pcgGetRandom64(&rngState);
+    zobrist.blackKingCastle = pcgGetRandom64(&rngState);
+    zobrist.whiteKingCastle = pcgGetRandom64(&rngState);
+}
+
+void initSearch(void)
+{
+    static const int knightOffsets[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    static const int kingOffsets[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+    static const int rayDirections[8][2] = {{-1, -1}, {1, -1}, {-1, 1}, {1, 1}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (int cell = 0; cell < 64; cell++)
+    {
+        int col = cell % 8;
+        int row = cell / 8;
+        numKnightTargets[cell] = 0;
+        numKingTargets[cell] = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            rayLengths[cell][i] = 0;
+            for (int x = col + rayDirections[i][0], y = row + rayDirections[i][1]; x >= 0 && x < 8 && y >= 0 && y < 8;
+                x += rayDirections[i][0], y += rayDirections[i][1])
+            {
+                rays[cell][i][rayLengths[cell][i]++] = (y * 8) + x;
+            }
+        }
+        for (int i = 0; i < 8; i++)
+        {
+            int x = col + knightOffsets[i][0];
+            int y = row + knightOffsets[i][1];
+            if (x >= 0 && x < 8 && y >= 0 && y < 8)
+            {
+                knightTargets[cell][numKnightTargets[cell]++] = (y * 8) + x;
+            }
+            x = col + kingOffsets[i][0];
+            y = row + kingOffsets[i][1];
+            if (x >= 0 && x < 8 && y >= 0 && y < 8)
+            {
+                kingTargets[cell][numKingTargets[cell]++] = (y * 8) + x;
+            }
+        }
+    }
+    for (int depth = 1; depth < MAX_SEARCH_DEPTH; depth++)
+    {
+        for (int move = 1; move < 64; move++)
+        {
+            lateMoveReductions[depth][move] = (int)(0.5 + (log(depth) * log(move) / 2.0));
+        }
+    }
+    if (transpositionTable == NULL)
+    {
+        setHashSize(DEFAULT_HASH_SIZE);
     }
-    zobrist.playerToMove = pcgGetRandom64();
-    zobrist.blackQueenCastle = pcgGetRandom64();
-    zobrist.whiteQueenCastle = pcgGetRandom64();
-    zobrist.blackKingCastle = pcgGetRandom64();
-    zobrist.whiteKingCastle = pcgGetRandom64();
 }
 
 void initGameState(void)
@@ -1350,6 +2810,7 @@ void initGameState(void)
     gameState.board[63] = WHITE | ROOK;
 
     hashStartingPosition();
+    scorePosition(&gameState);
 }
 
 static void testFen(const char *fen, int depth, uint64_t expected, bool verbose)
@@ -1379,3 +2840,171 @@ void runTests(bool verbose)
     testFen("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194, verbose);
     testFen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5, 164075551, verbose);
 }
+
+// Long algebraic notation, e.g. e2e4 or e7e8q
+void moveToString(uint16_t move, char *string)
+{
+    uint8_t moveFrom = (move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
+    uint8_t moveTo = move & MOVE_TO_MASK;
+    string[0] = 'a' + (moveFrom % 8);
+    string[1] = '8' - (moveFrom / 8);
+    string[2] = 'a' + (moveTo % 8);
+    string[3] = '8' - (moveTo / 8);
+    switch ((move & PAWN_PROMOTE_MASK) >> PAWN_PROMOTE_SHIFT)
+    {
+        case QUEEN:
+            string[4] = 'q';
+            break;
+        case BISHOP:
+            string[4] = 'b';
+            break;
+        case ROOK:
+            string[4] = 'r';
+            break;
+        case KNIGHT:
+            string[4] = 'n';
+            break;
+        default:
+            string[4] = 0;
+            break;
+    }
+    string[5] = 0;
+}
+
+/* Multi-PV.  Each iteration searches the root moves once per line with a full window,
+   leaving out the moves already picked for the lines above.  The transposition table
+   carries over between lines, so the later ones are cheap.  Returns the depth completed. */
+static int analyzePosition(uint16_t *lineMoves, int *lineScores, int numLines, SearchThread *thread)
+{
+    int completedDepth = 0;
+    for (int depth = 1; depth <= thread->maxDepth; depth++)
+    {
+        int scores[1024];
+        for (int line = 0; line < numLines; line++)
+        {
+            int alpha = CHECKMATE_EVALUATION;
+            int beta = -CHECKMATE_EVALUATION + 1;
+            int best = line;
+            for (int i = line; i < thread->numMoves; i++)
+            {
+                GameState copyState;
+                copyGameState(&copyState, &thread->state);
+                movePiece(thread->moves[i], &copyState);
+                int newDepth = extendedDepth(depth, 0, playerInCheck(&copyState), thread->numMoves == 1, &thread->data);
+                int score;
+                if (i == line)
+                {
+                    score = -AISearch(newDepth, 1, &copyState, -beta, -alpha, thread->moves[i], &thread->data);
+                }
+                else
+                {
+                    score = -AISearch(newDepth, 1, &copyState, -alpha - 1, -alpha, thread->moves[i], &thread->data);
+                    if (score > alpha)
+                    {
+                        score = -AISearch(newDepth, 1, &copyState, -beta, -alpha, thread->moves[i], &thread->data);
+                    }
+                }
+                if (searchStopped(&thread->data))
+                {
+                    return completedDepth;
+                }
+                if (score > alpha)
+                {
+                    alpha = score;
+                    best = i;
+                }
+            }
+            uint16_t bestMove = thread->moves[best];
+            thread->moves[best] = thread->moves[line];
+            thread->moves[line] = bestMove;
+            scores[line] = alpha;
+        }
+        for (int line = 0; line < numLines; line++)
+        {
+            lineMoves[line] = thread->moves[line];
+            lineScores[line] = scores[line];
+        }
+        completedDepth = depth;
+    }
+    return completedDepth;
+}
+
+// Logs a line's score and principal variation, following hash moves after the first move.
+static void logAnalysisLine(int line, uint16_t move, int score, int depth)
+{
+    char logString[1024];
+    int length;
+    int mate = mateDistance(score);
+    if (mate != 0)
+    {
+        length = snprintf(logString, sizeof(logString), "%d: mate %d pv", line + 1, mate);
+    }
+    else
+    {
+        length = snprintf(logString, sizeof(logString), "%d: score %d pv", line + 1, score);
+    }
+    uint16_t pv[MAX_PV_LENGTH];
+    int pvLength = principalVariation(move, &gameState, depth < MAX_PV_LENGTH ? depth : MAX_PV_LENGTH, pv);
+    for (int i = 0; i < pvLength; i++)
+    {
+        logString[length++] = ' ';
+        moveToString(pv[i], &logString[length]);
+        length += strlen(&logString[length]);
+    }
+    debugLog(logString);
+}
+
+/* Analyzes every FEN in a file (one per line) with the current search limits
+   and logs the best numLines moves with their scores and principal variations. */
+void runAnalysis(const char *fileName, int numLines)
+{
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL)
+    {
+        debugLog("runAnalysis: Failed to open file");
+        return;
+    }
+    SearchThread *thread = malloc(sizeof(SearchThread));
+    if (thread == NULL)
+    {
+        debugLog("runAnalysis: malloc failed");
+        fclose(file);
+        return;
+    }
+    char fen[256];
+    while (fgets(fen, sizeof(fen), file) != NULL)
+    {
+        fen[strcspn(fen, "\r\n")] = 0;
+        if (fen[0] == 0)
+        {
+            continue;
+        }
+        loadFenString(fen);
+        debugLog(fen);
+        memset(thread, 0, sizeof(SearchThread));
+        thread->state = gameState;
+        thread->maxDepth = searchLimits.depth < MAX_SEARCH_DEPTH ? searchLimits.depth : MAX_SEARCH_DEPTH - 1;
+        searchAborted = false;
+        SearchLimits limits = searchLimits;
+        limits.stop = &searchAborted;
+        thread->data.limits = &limits;
+        thread->data.startTime = getTime();
+        thread->data.hashStack[0] = gameState.hash;
+        thread->data.numGameHashes = collectGameHistory(thread->data.gameHashes);
+        thread->numMoves = getAllLegalMoves(thread->moves, &thread->state);
+        orderMoves(thread->moves, thread->numMoves, 0, 0, 0, &thread->data, &thread->state);
+        int lines = numLines < thread->numMoves ? numLines : thread->numMoves;
+        uint16_t lineMoves[1024];
+        int lineScores[1024];
+        int depth = analyzePosition(lineMoves, lineScores, lines, thread);
+        char logString[LOG_SIZE];
+        snprintf(logString, LOG_SIZE, "depth %d nodes %" PRIu64, depth, thread->data.nodes);
+        debugLog(logString);
+        for (int i = 0; i < lines && depth > 0; i++)
+        {
+            logAnalysisLine(i, lineMoves[i], lineScores[i], depth);
+        }
+    }
+    free(thread);
+    fclose(file);
+}
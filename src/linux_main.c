@@ -56,7 +56,10 @@ static void *playerGameLoop(void *arg)
         highlighted[0] = (move & MOVE_FROM_MASK) >> MOVE_FROM_SHIFT;
         highlighted[1] = move & MOVE_TO_MASK;
         numHightlighted = 2;
-        handleGameOver();
+        if (!handleGameOver())
+        {
+            startPondering();
+        }
         renderFrame();
         AIisThinking = false;
         pthread_mutex_unlock(&mutex);
@@ -150,6 +153,7 @@ static void mainThreadLoop(bool playerGame)
             flags |= handleNextEvent(&newWidth, &newHeight, playerGame);
             if (flags & QUIT)
             {
+                stopSearch();
                 return;
             }
         }
@@ -206,6 +210,49 @@ int main(int argc, char **argv)
         return 1;
     }
     initZobrist();
+    initSearch();
+    int searchDepth = 0;
+    uint64_t searchNodes = 0;
+    uint64_t searchTime = 0;
+    const char *analysisFile = NULL;
+    int analysisLines = 3;
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-threads") == 0)
+        {
+            setSearchThreads(atoi(argv[i + 1]));
+        }
+        else if (strcmp(argv[i], "-depth") == 0)
+        {
+            searchDepth = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-nodes") == 0)
+        {
+            searchNodes = strtoull(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-movetime") == 0)
+        {
+            searchTime = strtoull(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-analyze") == 0)
+        {
+            analysisFile = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-lines") == 0)
+        {
+            analysisLines = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-nnue") == 0 && !loadNetwork(argv[i + 1]))
+        {
+            puts("Failed to load network, using the classical evaluation");
+        }
+    }
+    setSearchLimits(searchDepth, searchNodes, searchTime);
+    if (analysisFile != NULL)
+    {
+        runAnalysis(analysisFile, analysisLines);
+        return 0;
+    }
     if (argc > 1 && strcmp(argv[1], "-test") == 0)
     {
         bool verboseTest = false;
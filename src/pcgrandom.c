@@ -2,25 +2,25 @@
 
 RngState rngState;
 
-uint32_t pcgGetRandom(void)
+uint32_t pcgGetRandom(RngState *rng)
 {
-    uint64_t oldstate = rngState.state;
-    rngState.state = oldstate * 6364136223846793005ULL + rngState.inc;
+    uint64_t oldstate = rng->state;
+    rng->state = oldstate * 6364136223846793005ULL + rng->inc;
     uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
     uint32_t rot = oldstate >> 59u;
     return (xorshifted >> rot) | (xorshifted << ((0 - rot) & 31));
 }
 
-uint64_t pcgGetRandom64(void)
+uint64_t pcgGetRandom64(RngState *rng)
 {
-    uint64_t randomHigh = pcgGetRandom();
-    uint64_t randomLow = pcgGetRandom();
+    uint64_t randomHigh = pcgGetRandom(rng);
+    uint64_t randomLow = pcgGetRandom(rng);
     return (randomHigh << 32) | randomLow;
 }
 
-uint32_t pcgRangedRandom(uint32_t range)
+uint32_t pcgRangedRandom(uint32_t range, RngState *rng)
 {
-    uint32_t x = pcgGetRandom();
+    uint32_t x = pcgGetRandom(rng);
     uint64_t m = (uint64_t)x * (uint64_t)range;
     uint32_t l = (uint32_t)m;
     if (l < range)
@@ -28,7 +28,7 @@ uint32_t pcgRangedRandom(uint32_t range)
         uint32_t t = (0 - range) % range;
         while (l < t)
         {
-            x = pcgGetRandom();
+            x = pcgGetRandom(rng);
             m = (uint64_t)x * (uint64_t)range;
             l = (uint32_t)m;
         }
@@ -0,0 +1,94 @@
+#include "platform.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/* Threads and the clock don't depend on the window system, so the GUI and UCI
+   builds share this file. */
+
+#ifdef _WIN32
+typedef struct WindowsThread
+{
+	HANDLE handle;
+	void *(*function)(void *);
+	void *arg;
+} WindowsThread;
+
+static DWORD WINAPI windowsThreadStart(_In_ LPVOID lpParameter)
+{
+	WindowsThread *thread = lpParameter;
+	thread->function(thread->arg);
+	return 0;
+}
+
+void *createThread(void *(*function)(void *), void *arg)
+{
+	WindowsThread *thread = malloc(sizeof(WindowsThread));
+	if (thread == NULL)
+	{
+		debugLog("malloc failed");
+		return NULL;
+	}
+	thread->function = function;
+	thread->arg = arg;
+	thread->handle = CreateThread(NULL, 0, windowsThreadStart, thread, 0, NULL);
+	if (thread->handle == NULL)
+	{
+		debugLog("CreateThread failed");
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+void joinThread(void *thread)
+{
+	WindowsThread *windowsThread = thread;
+	WaitForSingleObject(windowsThread->handle, INFINITE);
+	CloseHandle(windowsThread->handle);
+	free(windowsThread);
+}
+
+// Milliseconds from a monotonic clock
+uint64_t getTime(void)
+{
+	return GetTickCount64();
+}
+#else
+void *createThread(void *(*function)(void *), void *arg)
+{
+	pthread_t *thread = malloc(sizeof(pthread_t));
+	if (thread == NULL)
+	{
+		debugLog("malloc failed");
+		return NULL;
+	}
+	if (pthread_create(thread, NULL, function, arg) != 0)
+	{
+		debugLog("pthread_create failed");
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+void joinThread(void *thread)
+{
+	pthread_join(*(pthread_t *)thread, NULL);
+	free(thread);
+}
+
+// Milliseconds from a monotonic clock
+uint64_t getTime(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+#endif
@@ -0,0 +1,413 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "nnue.h"
+#include "pcgrandom.h"
+#include "platform.h"
+
+// Universal Chess Interface front end.  Reads commands on stdin and answers on stdout.
+
+#define MAX_DEPTH 63 // Deepest the engine searches
+#define MOVE_OVERHEAD 20 // Milliseconds kept back from the clock for communication
+#define DEFAULT_MOVES_TO_GO 20 // Clock share when the GUI doesn't say how many moves are left
+#define DEFAULT_HASH_SIZE 16
+#define MAX_HASH_SIZE 65536
+#define MAX_THREADS 64
+#define BENCH_DEPTH 6
+
+static void *searchThread;
+static bool infiniteSearch; // bestmove is held back until stop
+static uint16_t searchMove;
+static uint64_t benchNodes;
+
+static const char *benchPositions[] =
+{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1"
+};
+
+static void printBestMove(uint16_t move)
+{
+    char moveString[6];
+    moveToString(move, moveString);
+    printf("bestmove %s\n", move != 0 ? moveString : "0000");
+    fflush(stdout);
+}
+
+static void printInfo(const SearchInfo *info)
+{
+    if (info->terminal)
+    {
+        printf("info depth 0 score %s\n", info->score < 0 ? "mate 0" : "cp 0");
+        fflush(stdout);
+        return;
+    }
+    char line[1024];
+    uint64_t nps = info->nodes * 1000 / (info->time > 0 ? info->time : 1);
+    int length;
+    if (info->mate != 0)
+    {
+        length = snprintf(line, sizeof(line), "info depth %d score mate %d", info->depth, info->mate);
+    }
+    else
+    {
+        length = snprintf(line, sizeof(line), "info depth %d score cp %d", info->depth, info->score);
+    }
+    length += snprintf(line + length, sizeof(line) - length, " nodes %" PRIu64 " nps %" PRIu64 " time %" PRIu64 " pv",
+        info->nodes, nps, info->time);
+    for (int i = 0; i < info->pvLength; i++)
+    {
+        line[length++] = ' ';
+        moveToString(info->pv[i], &line[length]);
+        length += strlen(&line[length]);
+    }
+    puts(line);
+    fflush(stdout);
+}
+
+static void recordBenchNodes(const SearchInfo *info)
+{
+    benchNodes = info->nodes;
+}
+
+static void *runSearch(void *arg)
+{
+    searchMove = getComputerMove();
+    if (!infiniteSearch)
+    {
+        printBestMove(searchMove);
+    }
+    return NULL;
+}
+
+// Stops the search in progress, if any, and waits for it.  An infinite search sends its move now.
+static void finishSearch(void)
+{
+    if (searchThread == NULL)
+    {
+        return;
+    }
+    stopSearch();
+    joinThread(searchThread);
+    searchThread = NULL;
+    if (infiniteSearch)
+    {
+        printBestMove(searchMove);
+    }
+}
+
+static char *nextToken(char **string)
+{
+    char *token = *string;
+    while (*token == ' ')
+    {
+        token++;
+    }
+    if (*token == 0)
+    {
+        return NULL;
+    }
+    char *end = strchr(token, ' ');
+    if (end != NULL)
+    {
+        *end = 0;
+        *string = end + 1;
+    }
+    else
+    {
+        *string = token + strlen(token);
+    }
+    return token;
+}
+
+static bool playMove(const char *moveString)
+{
+    uint16_t moves[1024];
+    int numMoves = getAllLegalMoves(moves, &gameState);
+    for (int i = 0; i < numMoves; i++)
+    {
+        char legalMove[6];
+        moveToString(moves[i], legalMove);
+        if (strcmp(legalMove, moveString) == 0)
+        {
+            movePiece(moves[i], &gameState);
+            return true;
+        }
+    }
+    return false;
+}
+
+// position startpos [moves ...] or position fen FEN [moves ...]
+static void setPosition(char *arguments)
+{
+    char *moves = strstr(arguments, "moves");
+    if (moves != NULL)
+    {
+        moves[-1] = 0;
+        moves += 5;
+    }
+    char *token = nextToken(&arguments);
+    if (token == NULL)
+    {
+        return;
+    }
+    if (strcmp(token, "startpos") == 0)
+    {
+        initGameState();
+    }
+    else if (strcmp(token, "fen") == 0)
+    {
+        // The move counters are optional
+        char fen[256];
+        int fields = 0;
+        int length = 0;
+        for (token = nextToken(&arguments); token != NULL && fields < 6; token = nextToken(&arguments))
+        {
+            length += snprintf(fen + length, sizeof(fen) - length, fields > 0 ? " %s" : "%s", token);
+            fields++;
+        }
+        if (fields < 4)
+        {
+            debugLog("position: bad FEN");
+            return;
+        }
+        snprintf(fen + length, sizeof(fen) - length, fields == 4 ? " 0 1" : fields == 5 ? " 1" : "");
+        loadFenString(fen);
+    }
+    else
+    {
+        return;
+    }
+    if (moves != NULL)
+    {
+        for (token = nextToken(&moves); token != NULL; token = nextToken(&moves))
+        {
+            if (!playMove(token))
+            {
+                debugLog("position: illegal move");
+                return;
+            }
+        }
+    }
+}
+
+// go [depth N] [nodes N] [movetime MS] [wtime MS] [btime MS] [winc MS] [binc MS] [movestogo N] [infinite]
+static void startSearch(char *arguments)
+{
+    int depth = 0;
+    uint64_t nodes = 0;
+    uint64_t moveTime = 0;
+    uint64_t clocks[2] = {0, 0};
+    uint64_t increments[2] = {0, 0};
+    uint64_t movesToGo = 0;
+    infiniteSearch = false;
+    for (char *token = nextToken(&arguments); token != NULL; token = nextToken(&arguments))
+    {
+        if (strcmp(token, "infinite") == 0)
+        {
+            infiniteSearch = true;
+            continue;
+        }
+        char *value = nextToken(&arguments);
+        if (value == NULL)
+        {
+            break;
+        }
+        if (strcmp(token, "depth") == 0)
+        {
+            depth = atoi(value);
+        }
+        else if (strcmp(token, "nodes") == 0)
+        {
+            nodes = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "movetime") == 0)
+        {
+            moveTime = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "wtime") == 0)
+        {
+            clocks[0] = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "btime") == 0)
+        {
+            clocks[1] = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "winc") == 0)
+        {
+            increments[0] = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "binc") == 0)
+        {
+            increments[1] = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "movestogo") == 0)
+        {
+            movesToGo = strtoull(value, NULL, 10);
+        }
+    }
+    int side = gameState.playerToMove == WHITE ? 0 : 1;
+    uint64_t time = moveTime;
+    if (time == 0 && clocks[side] > 0 && !infiniteSearch)
+    {
+        // A share of the clock plus most of the increment, never more than half of what's left
+        uint64_t available = clocks[side] > MOVE_OVERHEAD ? clocks[side] - MOVE_OVERHEAD : 0;
+        time = available / (movesToGo > 0 ? movesToGo : DEFAULT_MOVES_TO_GO) + increments[side] * 3 / 4;
+        if (time > available / 2)
+        {
+            time = available / 2;
+        }
+        if (time == 0)
+        {
+            time = 1;
+        }
+    }
+    setSearchLimits(depth > 0 && depth <= MAX_DEPTH ? depth : MAX_DEPTH, nodes, time);
+    searchThread = createThread(runSearch, NULL);
+    if (searchThread == NULL)
+    {
+        debugLog("go: failed to start the search");
+        printBestMove(0);
+    }
+}
+
+// setoption name NAME value VALUE
+static void setOption(char *arguments)
+{
+    char *name = strstr(arguments, "name ");
+    char *value = strstr(arguments, " value ");
+    if (name == NULL || value == NULL)
+    {
+        return;
+    }
+    *value = 0;
+    name += 5;
+    value += 7;
+    if (strcmp(name, "Hash") == 0)
+    {
+        int megabytes = atoi(value);
+        setHashSize(megabytes < 1 ? 1 : megabytes > MAX_HASH_SIZE ? MAX_HASH_SIZE : megabytes);
+    }
+    else if (strcmp(name, "Threads") == 0)
+    {
+        setSearchThreads(atoi(value));
+    }
+}
+
+/* Searches a fixed set of positions to a fixed depth from an empty transposition table.
+   The node count is a signature of the search.  It should only change when the search does. */
+static void runBench(int depth)
+{
+    uint64_t totalNodes = 0;
+    uint64_t startTime = getTime();
+    setSearchReport(recordBenchNodes);
+    setSearchLimits(depth, 0, 0);
+    for (size_t i = 0; i < sizeof(benchPositions) / sizeof(benchPositions[0]); i++)
+    {
+        clearHash();
+        loadFenString(benchPositions[i]);
+        benchNodes = 0;
+        getComputerMove();
+        totalNodes += benchNodes;
+    }
+    uint64_t time = getTime() - startTime;
+    setSearchReport(printInfo);
+    initGameState();
+    printf("%" PRIu64 " nodes %" PRIu64 " nps\n", totalNodes, totalNodes * 1000 / (time > 0 ? time : 1));
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    // A fixed seed keeps searches, and the bench node count, the same from run to run
+    rngState.state = 0x853C49E6748FEA9BULL;
+    rngState.inc = 0xDA3E39CB94B95BDBULL;
+    initZobrist();
+    initSearch();
+    initGameState();
+    setSearchReport(printInfo);
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-nnue") == 0 && !loadNetwork(argv[i + 1]))
+        {
+            debugLog("Failed to load network, using the classical evaluation");
+        }
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    {
+        runBench(argc > 2 ? atoi(argv[2]) : BENCH_DEPTH);
+        return 0;
+    }
+    char line[16384];
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        char *arguments = line;
+        char *command = nextToken(&arguments);
+        if (command == NULL)
+        {
+            continue;
+        }
+        if (strcmp(command, "uci") == 0)
+        {
+            puts("id name Chess");
+            puts("id author Chess contributors");
+            printf("option name Hash type spin default %d min 1 max %d\n", DEFAULT_HASH_SIZE, MAX_HASH_SIZE);
+            printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+            puts("uciok");
+            fflush(stdout);
+        }
+        else if (strcmp(command, "isready") == 0)
+        {
+            puts("readyok");
+            fflush(stdout);
+        }
+        else if (strcmp(command, "ucinewgame") == 0)
+        {
+            finishSearch();
+            clearHash();
+        }
+        else if (strcmp(command, "position") == 0)
+        {
+            finishSearch();
+            setPosition(arguments);
+        }
+        else if (strcmp(command, "go") == 0)
+        {
+            finishSearch();
+            startSearch(arguments);
+        }
+        else if (strcmp(command, "stop") == 0)
+        {
+            finishSearch();
+        }
+        else if (strcmp(command, "setoption") == 0)
+        {
+            finishSearch();
+            setOption(arguments);
+        }
+        else if (strcmp(command, "bench") == 0)
+        {
+            finishSearch();
+            char *depth = nextToken(&arguments);
+            runBench(depth != NULL ? atoi(depth) : BENCH_DEPTH);
+        }
+        else if (strcmp(command, "quit") == 0)
+        {
+            break;
+        }
+    }
+    finishSearch();
+    return 0;
+}
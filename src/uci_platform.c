@@ -0,0 +1,46 @@
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Platform layer for the UCI build.  There's no window, so drawing is a no-op
+   and log messages go to the GUI as info strings. */
+
+void blitToScreen(void)
+{
+}
+
+void *loadFile(const char *fileName)
+{
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    void *data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        long size = ftell(file);
+        if (size > 0 && fseek(file, 0, SEEK_SET) == 0)
+        {
+            data = malloc(size);
+            if (data != NULL && fread(data, 1, size, file) != (size_t)size)
+            {
+                free(data);
+                data = NULL;
+            }
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+void debugLog(const char *message)
+{
+    printf("info string %s\n", message);
+    fflush(stdout);
+}
+
+void makeComputerMove(void)
+{
+}
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "game.h"
@@ -105,6 +106,10 @@ LRESULT CALLBACK WindowsCallback(_In_ HWND hwnd, _In_ UINT Msg, _In_ WPARAM wPar
 			renderFrame();
 			if (playerGame || gameOver)
 			{
+				if (playerGame && !gameOver)
+				{
+					startPondering();
+				}
 				AIisThinking = false;
 			}
 			else
@@ -160,6 +165,69 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 		return 1;
 	}
 	initZobrist();
+	initSearch();
+	const char *threadsArg = strstr(lpCmdLine, "-threads ");
+	if (threadsArg != NULL)
+	{
+		setSearchThreads(atoi(threadsArg + strlen("-threads ")));
+	}
+	int searchDepth = 0;
+	uint64_t searchNodes = 0;
+	uint64_t searchTime = 0;
+	const char *depthArg = strstr(lpCmdLine, "-depth ");
+	if (depthArg != NULL)
+	{
+		searchDepth = atoi(depthArg + strlen("-depth "));
+	}
+	const char *nodesArg = strstr(lpCmdLine, "-nodes ");
+	if (nodesArg != NULL)
+	{
+		searchNodes = strtoull(nodesArg + strlen("-nodes "), NULL, 10);
+	}
+	const char *timeArg = strstr(lpCmdLine, "-movetime ");
+	if (timeArg != NULL)
+	{
+		searchTime = strtoull(timeArg + strlen("-movetime "), NULL, 10);
+	}
+	setSearchLimits(searchDepth, searchNodes, searchTime);
+	const char *networkArg = strstr(lpCmdLine, "-nnue ");
+	if (networkArg != NULL)
+	{
+		char networkFile[MAX_PATH];
+		networkArg += strlen("-nnue ");
+		size_t fileNameLength = strcspn(networkArg, " ");
+		if (fileNameLength >= MAX_PATH)
+		{
+			fileNameLength = MAX_PATH - 1;
+		}
+		memcpy(networkFile, networkArg, fileNameLength);
+		networkFile[fileNameLength] = 0;
+		if (!loadNetwork(networkFile))
+		{
+			OutputDebugStringA("Failed to load network, using the classical evaluation\r\n");
+		}
+	}
+	const char *analyzeArg = strstr(lpCmdLine, "-analyze ");
+	if (analyzeArg != NULL)
+	{
+		char analysisFile[MAX_PATH];
+		analyzeArg += strlen("-analyze ");
+		size_t fileNameLength = strcspn(analyzeArg, " ");
+		if (fileNameLength >= MAX_PATH)
+		{
+			fileNameLength = MAX_PATH - 1;
+		}
+		memcpy(analysisFile, analyzeArg, fileNameLength);
+		analysisFile[fileNameLength] = 0;
+		int analysisLines = 3;
+		const char *linesArg = strstr(lpCmdLine, "-lines ");
+		if (linesArg != NULL)
+		{
+			analysisLines = atoi(linesArg + strlen("-lines "));
+		}
+		runAnalysis(analysisFile, analysisLines);
+		return 0;
+	}
 	if (strcmp(lpCmdLine, "-test") == 0)
 	{
 		runTests(false);
@@ -229,7 +297,7 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 	loadFont();
 	initGameState();
 	renderFrame();
-	if (strcmp(lpCmdLine, "-ai") == 0)
+	if (strstr(lpCmdLine, "-ai") != NULL)
 	{
 		AIisThinking = true;
 	}
@@ -249,6 +317,7 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 		BOOL messageReturn = GetMessageA(&message, window, 0, 0);
 		if (messageReturn == 0 || messageReturn == -1)
 		{
+			stopSearch();
 			break;
 		}
 		TranslateMessage(&message);
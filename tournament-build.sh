@@ -0,0 +1 @@
+gcc lichess-bot/src/lichess_tournament.c lichess-bot/src/lichess_random.c lichess-bot/src/lichess_game.c lichess-bot/src/lichess_nnue.c -I lichess-bot/include -I include -o tournament -std=c99 -Wall -O3 -pthread -lpthread -lm
@@ -0,0 +1 @@
+gcc -DTUNING lichess-bot/src/lichess_tuner.c lichess-bot/src/lichess_random.c lichess-bot/src/lichess_game.c lichess-bot/src/lichess_nnue.c -I lichess-bot/include -I include -o tuner -std=c99 -Wall -O3 -pthread -lpthread -lm